@@ -18,30 +18,58 @@ windows {
 CONFIG += c++11
 
 HEADERS += \
+    decompressed_cache.h \
+    download_location.h \
     drivemanager.h \
     releasemanager.h \
+    md5sum_fetcher.h \
+    metadata_cache.h \
     network.h \
+    peer_cache.h \
+    prefetch.h \
     notifications.h \
     image_download.h \
+    image_files.h \
+    icon_provider.h \
+    image_probe.h \
     progress.h \
     file_type.h \
     architecture.h \
+    catalog.h \
     release.h \
     release_model.h \
+    search_index.h \
+    settings.h \
+    throughput.h \
+    trace.h \
     units.h \
     variant.h
 
 SOURCES += main.cpp \
+    decompressed_cache.cpp \
+    download_location.cpp \
     drivemanager.cpp \
     releasemanager.cpp \
+    md5sum_fetcher.cpp \
+    metadata_cache.cpp \
     network.cpp \
+    peer_cache.cpp \
+    prefetch.cpp \
     notifications.cpp \
     image_download.cpp \
+    image_files.cpp \
+    icon_provider.cpp \
+    image_probe.cpp \
     progress.cpp \
     file_type.cpp \
     architecture.cpp \
+    catalog.cpp \
     release.cpp \
     release_model.cpp \
+    search_index.cpp \
+    settings.cpp \
+    throughput.cpp \
+    trace.cpp \
     units.cpp \
     variant.cpp
 
@@ -49,6 +77,12 @@ RESOURCES += qml.qrc \
     assets.qrc \
     ../translations/translations.qrc
 
+# Catalog snapshot is optional, it's generated by
+# dist/catalog/update_catalog.sh
+exists(assets/catalog/catalog.qrc) {
+    RESOURCES += assets/catalog/catalog.qrc
+}
+
 lupdate_only {
     SOURCES += $$PWD/*.qml \
         $$PWD/complex/*.qml \
@@ -66,6 +100,8 @@ INSTALLS += target
 
 linux {
     QT += dbus x11extras
+    CONFIG += link_pkgconfig
+    PKGCONFIG += liblzma
 
     HEADERS += linuxdrivemanager.h
     SOURCES += linuxdrivemanager.cpp
@@ -92,7 +128,7 @@ win32 {
     SOURCES += windrivemanager.cpp
     RESOURCES += windowsicon.qrc
 
-    LIBS += -ldbghelp
+    LIBS += -ldbghelp -llzma
 
     # Until I find out how (or if it's even possible at all) to run a privileged process from an unprivileged one, the main binary will be privileged too
     DISTFILES += windows.manifest
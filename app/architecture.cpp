@@ -23,6 +23,7 @@
 #include "architecture.h"
 
 #include <QObject>
+#include <QSysInfo>
 
 const QList<Architecture> architecture_all = []() {
     QList<Architecture> out;
@@ -92,3 +93,28 @@ Architecture architecture_from_filename(const QString &filename) {
     }
     return Architecture_UNKNOWN;
 }
+
+// NOTE: QSysInfo uses its own names for architectures
+Architecture architecture_host() {
+    const QString host = QSysInfo::currentCpuArchitecture();
+
+    if (host == "x86_64") {
+        return Architecture_X86_64;
+    } else if (host == "i386") {
+        return Architecture_X86;
+    } else if (host == "arm64") {
+        return Architecture_AARCH64;
+    } else if (host == "arm") {
+        return Architecture_ARM;
+    } else if (host == "mips") {
+        return Architecture_MIPSEL;
+    } else if (host == "riscv64") {
+        return Architecture_RISCV64;
+    } else if (host == "power64") {
+        return Architecture_PPC64LE;
+    } else if (host == "e2k") {
+        return Architecture_E2K;
+    } else {
+        return Architecture_UNKNOWN;
+    }
+}
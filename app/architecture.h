@@ -46,5 +46,6 @@ QStringList architecture_strings(const Architecture architecture);
 QString architecture_name(const Architecture architecture);
 Architecture architecture_from_string(const QString &string);
 Architecture architecture_from_filename(const QString &filename);
+Architecture architecture_host();
 
 #endif // ARCHITECTURE_H
@@ -0,0 +1,322 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include "catalog.h"
+#include "icon_provider.h"
+#include "trace.h"
+
+#include <yaml-cpp/yaml.h>
+
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QLocale>
+#include <QRegExp>
+#include <QThread>
+
+static std::string yml_get(const YAML::Node &node, const char *key);
+static QString yml_get_text(const YAML::Node &node, const QString &key);
+
+CatalogParser *CatalogParser::create() {
+    qRegisterMetaType<CatalogSource>();
+    qRegisterMetaType<CatalogFile>();
+    qRegisterMetaType<QList<CatalogSource>>();
+    qRegisterMetaType<QList<CatalogFile>>();
+
+    auto thread = new QThread();
+    auto parser = new CatalogParser();
+    parser->moveToThread(thread);
+
+    QObject::connect(
+        thread, &QThread::finished,
+        parser, &QObject::deleteLater);
+    QObject::connect(
+        thread, &QThread::finished,
+        thread, &QObject::deleteLater);
+
+    // NOTE: thread has to be stopped before the
+    // application object is destroyed
+    QObject::connect(
+        QCoreApplication::instance(), &QCoreApplication::aboutToQuit,
+        thread, [thread]() {
+            thread->quit();
+            thread->wait();
+        });
+
+    thread->start();
+
+    return parser;
+}
+
+CatalogParser::CatalogParser()
+: QObject() {
+    connect(
+        this, &CatalogParser::fileRequested,
+        this, &CatalogParser::parseFile, Qt::QueuedConnection);
+    connect(
+        this, &CatalogParser::catalogRequested,
+        this, &CatalogParser::parseCatalog, Qt::QueuedConnection);
+}
+
+void CatalogParser::requestFile(const CatalogSource &source) {
+    emit fileRequested(source);
+}
+
+void CatalogParser::requestCatalog(const QList<CatalogSource> &sources) {
+    emit catalogRequested(sources);
+}
+
+void CatalogParser::parseFile(const CatalogSource &source) {
+    const qint64 trace_start_time = trace_now();
+    const CatalogFile file = parse(source);
+    trace_span("Parse file", "catalog", trace_start_time, {{"url", source.url}});
+
+    emit fileParsed(file);
+}
+
+// NOTE: whole catalog is emitted at once, so that it
+// can be loaded in one step
+void CatalogParser::parseCatalog(const QList<CatalogSource> &sources) {
+    QList<CatalogFile> files;
+
+    const qint64 trace_start_time = trace_now();
+
+    for (const CatalogSource &source : sources) {
+        const CatalogFile file = parse(source);
+        files.append(file);
+    }
+
+    trace_span("Parse catalog", "catalog", trace_start_time, {{"files", sources.size()}});
+
+    emit catalogParsed(files);
+}
+
+CatalogFile CatalogParser::parse(const CatalogSource &source) {
+    CatalogFile out;
+    out.url = source.url;
+    out.type = source.type;
+    out.hash = QCryptographicHash::hash(source.bytes, QCryptographicHash::Md5);
+
+    // NOTE: exceptions can't be allowed to leave the
+    // parser's thread, a broken file is treated as
+    // empty. Lookups in a document of the wrong shape
+    // throw too, not just loading.
+    try {
+        parseYaml(source, &out);
+    } catch (const YAML::Exception &e) {
+        qDebug() << "Failed to parse" << source.url << e.what();
+
+        out.releases.clear();
+        out.variants.clear();
+    }
+
+    return out;
+}
+
+// Fills releases or variants of the file, throws
+// YAML::Exception if the file is broken
+void CatalogParser::parseYaml(const CatalogSource &source, CatalogFile *out) {
+    const YAML::Node document = YAML::Load(std::string(source.bytes.constData(), source.bytes.size()));
+
+    if (source.type == CatalogFileType_SECTIONS) {
+        if (!document["members"]) {
+            return;
+        }
+
+        const QString language = []() {
+            if (QLocale().language() == QLocale::Russian) {
+                return "_ru";
+            } else {
+                return "_en";
+            }
+        }();
+
+        for (const YAML::Node &releaseData : document["members"]) {
+            CatalogRelease release;
+
+            release.name = intern(QString::fromStdString(yml_get(releaseData, "code")));
+            if (release.name.isEmpty()) {
+                qDebug() << "Release has no name";
+                continue;
+            }
+
+            release.display_name = yml_get_text(releaseData, "name" + language);
+            if (release.display_name.isEmpty()) {
+                qDebug() << "Release has no display name";
+                continue;
+            }
+
+            release.summary = yml_get_text(releaseData, "descr" + language);
+            if (release.summary.isEmpty()) {
+                qDebug() << "Release has no summary";
+                continue;
+            }
+
+            release.description = yml_get_text(releaseData, "descr_full" + language);
+            if (release.description.isEmpty()) {
+                qDebug() << "Release has no description";
+                continue;
+            }
+
+            // Check that icon file exists
+            const QString icon_name = QString::fromStdString(yml_get(releaseData, "img"));
+            if (icon_name.isEmpty()) {
+                qDebug() << "Release has no icon";
+                continue;
+            }
+
+            // NOTE: many releases share icons, so the
+            // check is done once per icon
+            if (!icon_exists.contains(icon_name)) {
+                icon_exists[icon_name] = IconProvider::exists(icon_name);
+            }
+            if (!icon_exists[icon_name]) {
+                qDebug() << "Failed to find icon" << icon_name << "needed for release" << release.name;
+                continue;
+            }
+
+            release.icon_path = intern(IconProvider::url(icon_name));
+
+            out->releases.append(release);
+        }
+    } else if (source.type == CatalogFileType_IMAGES) {
+        if (!document["entries"]) {
+            return;
+        }
+
+        for (const YAML::Node &variantData : document["entries"]) {
+            CatalogVariant variant;
+
+            variant.url = QString::fromStdString(yml_get(variantData, "link"));
+            if (variant.url.isEmpty()) {
+                qDebug() << "Variant has no url";
+                continue;
+            }
+
+            variant.release_name = intern(QString::fromStdString(yml_get(variantData, "solution")));
+            if (variant.release_name.isEmpty()) {
+                qDebug() << "Variant has no releaseName" << variant.url;
+                continue;
+            }
+
+            const QString arch_string = QString::fromStdString(yml_get(variantData, "arch"));
+            variant.arch = [arch_string, &variant]() -> Architecture {
+                if (!arch_string.isEmpty()) {
+                    return architecture_from_string(arch_string);
+                } else {
+                    return architecture_from_filename(variant.url);
+                }
+            }();
+            if (variant.arch == Architecture_UNKNOWN) {
+                qDebug() << "Variant has unknown architecture" << arch_string << variant.url;
+                continue;
+            }
+
+            // NOTE: yml file doesn't define "board" for pc32/pc64, so default to "PC"
+            variant.board = [this, variantData]() -> QString {
+                const QString board = QString::fromStdString(yml_get(variantData, "board"));
+                if (!board.isEmpty()) {
+                    return intern(board);
+                } else {
+                    return intern("PC");
+                }
+            }();
+
+            variant.file_type = file_type_from_filename(variant.url);
+            if (variant.file_type == FileType_UNKNOWN) {
+                qDebug() << "Variant has unknown file type" << variant.url;
+                continue;
+            }
+
+            variant.live = (yml_get(variantData, "live") == "1");
+
+            out->variants.append(variant);
+        }
+    }
+}
+
+QHash<QString, QString> catalog_parse_md5sum(const QByteArray &bytes) {
+    QHash<QString, QString> out;
+
+    // MD5SUM is of the form "sum image \n sum
+    // image \n ..."
+    const QList<QByteArray> line_list = bytes.split('\n');
+
+    for (const QByteArray &line : line_list) {
+        const QList<QString> elements = QString::fromUtf8(line).split(QRegExp("\\s+"));
+
+        if (elements.size() != 2) {
+            continue;
+        }
+
+        const QString md5sum = elements[0];
+        const QString filename = elements[1];
+
+        out[filename] = md5sum;
+    }
+
+    return out;
+}
+
+// Returns a copy of the string that shares data with
+// all previous equal strings
+QString CatalogParser::intern(const QString &string) {
+    if (!strings.contains(string)) {
+        strings[string] = string;
+    }
+
+    return strings[string];
+}
+
+// Used to check whether the catalog changed
+QByteArray catalog_hash(const QList<CatalogFile> &file_list) {
+    QCryptographicHash hash(QCryptographicHash::Md5);
+
+    for (const CatalogFile &file : file_list) {
+        hash.addData(file.hash);
+    }
+
+    return hash.result();
+}
+
+std::string yml_get(const YAML::Node &node, const char *key) {
+    const YAML::Node value_yml = node[key];
+    const std::string fallback = std::string();
+
+    return value_yml.as<std::string>(fallback);
+}
+
+// Gets a value that is displayed to the user
+QString yml_get_text(const YAML::Node &node, const QString &key) {
+    const std::string key_std = key.toStdString();
+    const std::string value_std = yml_get(node, key_std.c_str());
+    QString value = QString::fromStdString(value_std);
+
+    // Remove HTML character entities that don't render in Qt
+    value.replace("&colon;", ":");
+    value.replace("&nbsp;", " ");
+    // Remove newlines because text will have wordwrap
+    value.replace("\n", " ");
+
+    return value;
+}
@@ -0,0 +1,127 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef CATALOG_H
+#define CATALOG_H
+
+/*
+ * Catalog parser turns downloaded metadata files into typed
+ * records on a worker thread. Each file is parsed exactly
+ * once. Strings that repeat between records, like release
+ * names and boards, are interned so that records share
+ * them. ReleaseManager then only has to create releases
+ * and variants from ready records on the GUI thread.
+ */
+
+#include "architecture.h"
+#include "file_type.h"
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QMetaType>
+#include <QObject>
+#include <QString>
+
+enum CatalogFileType {
+    CatalogFileType_SECTIONS,
+    CatalogFileType_IMAGES,
+};
+
+struct CatalogRelease {
+    QString name;
+    QString display_name;
+    QString summary;
+    QString description;
+    QString icon_path;
+};
+
+struct CatalogVariant {
+    QString url;
+    QString release_name;
+    QString board;
+    Architecture arch;
+    FileType file_type;
+    bool live;
+};
+
+struct CatalogSource {
+    QString url;
+    CatalogFileType type;
+    QByteArray bytes;
+};
+
+struct CatalogFile {
+    QString url;
+    CatalogFileType type;
+    // Hash of file contents, used to check whether
+    // the catalog changed
+    QByteArray hash;
+    // Sections
+    QList<CatalogRelease> releases;
+    // Images
+    QList<CatalogVariant> variants;
+};
+
+Q_DECLARE_METATYPE(CatalogSource)
+Q_DECLARE_METATYPE(CatalogFile)
+
+class CatalogParser final : public QObject {
+    Q_OBJECT
+
+public:
+    // Creates a parser that runs on its own thread,
+    // until the application quits
+    static CatalogParser *create();
+
+    // Parsing is queued to the parser's thread, results
+    // are emitted by fileParsed() and catalogParsed()
+    void requestFile(const CatalogSource &source);
+    void requestCatalog(const QList<CatalogSource> &sources);
+
+signals:
+    void fileRequested(const CatalogSource &source);
+    void catalogRequested(const QList<CatalogSource> &sources);
+    void fileParsed(const CatalogFile &file);
+    void catalogParsed(const QList<CatalogFile> &files);
+
+private:
+    QHash<QString, QString> strings;
+    QHash<QString, bool> icon_exists;
+
+    CatalogParser();
+
+    void parseFile(const CatalogSource &source);
+    void parseCatalog(const QList<CatalogSource> &sources);
+
+    CatalogFile parse(const CatalogSource &source);
+    void parseYaml(const CatalogSource &source, CatalogFile *out);
+    QString intern(const QString &string);
+};
+
+QByteArray catalog_hash(const QList<CatalogFile> &file_list);
+
+// Parses an MD5SUM file into image name => md5sum
+QHash<QString, QString> catalog_parse_md5sum(const QByteArray &bytes);
+
+#endif // CATALOG_H
@@ -0,0 +1,131 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include "decompressed_cache.h"
+#include "settings.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSet>
+#include <QStandardPaths>
+
+static QSet<QString> files_being_cached;
+
+static QString cache_dir();
+static void trim();
+
+QString decompressed_cache_path(const QString &file_name) {
+    const QString decompressed_name = [file_name]() {
+        if (file_name.endsWith(".xz")) {
+            return file_name.left(file_name.length() - 3);
+        } else {
+            return file_name;
+        }
+    }();
+
+    return QDir(cache_dir()).filePath(decompressed_name);
+}
+
+QString decompressed_cache_md5(const QString &file_name, const QString &source_md5) {
+    const QString path = decompressed_cache_path(file_name);
+
+    QFile md5_file(path + ".md5");
+    const bool open_success = md5_file.open(QIODevice::ReadOnly);
+    if (!open_success || !QFile::exists(path)) {
+        return QString();
+    }
+
+    // "<decompressed md5> <compressed md5>"
+    const QStringList sums = QString(md5_file.readAll()).trimmed().split(' ');
+    if (sums.size() != 2 || sums[1] != source_md5) {
+        return QString();
+    }
+
+    return sums[0];
+}
+
+// NOTE: modification time of the ".md5" file is used as
+// the time of last use. Rewriting the same contents
+// updates it.
+void decompressed_cache_touch(const QString &file_name) {
+    QFile md5_file(decompressed_cache_path(file_name) + ".md5");
+
+    const bool open_success = md5_file.open(QIODevice::ReadWrite);
+    if (open_success) {
+        const QByteArray contents = md5_file.readAll();
+        md5_file.seek(0);
+        md5_file.write(contents);
+    }
+}
+
+// NOTE: two writes making a copy of the same image at
+// the same time would write to the same file
+bool decompressed_cache_start(const QString &file_name) {
+    if (files_being_cached.contains(file_name)) {
+        return false;
+    }
+
+    files_being_cached.insert(file_name);
+
+    return true;
+}
+
+void decompressed_cache_finish(const QString &file_name) {
+    files_being_cached.remove(file_name);
+
+    trim();
+}
+
+void trim() {
+    const qint64 size_max = settings_decompressed_cache_size();
+    const QDir dir(cache_dir());
+
+    // Least recently used first
+    QFileInfoList md5_list = dir.entryInfoList({"*.md5"}, QDir::Files, QDir::Time | QDir::Reversed);
+
+    qint64 total = 0;
+    for (const QFileInfo &md5_info : md5_list) {
+        const QString image_path = md5_info.filePath().left(md5_info.filePath().length() - 4);
+        total += QFileInfo(image_path).size();
+    }
+
+    while (total > size_max && !md5_list.isEmpty()) {
+        const QFileInfo md5_info = md5_list.takeFirst();
+        const QString image_path = md5_info.filePath().left(md5_info.filePath().length() - 4);
+
+        qDebug() << "Removing" << image_path << "from decompressed cache";
+
+        total -= QFileInfo(image_path).size();
+        QFile::remove(image_path);
+        QFile::remove(md5_info.filePath());
+    }
+}
+
+QString cache_dir() {
+    const QString out = QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath("decompressed");
+    QDir().mkpath(out);
+
+    return out;
+}
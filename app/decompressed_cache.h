@@ -0,0 +1,62 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef DECOMPRESSED_CACHE_H
+#define DECOMPRESSED_CACHE_H
+
+/*
+ * Decompressed cache keeps decompressed copies of
+ * recently written compressed images, so that writing
+ * the same image again doesn't have to decompress it.
+ * The copy is made by the helper during the first write
+ * and is sparse. Next to each copy, a ".md5" file records
+ * md5 sums of the decompressed data and of the compressed
+ * image it came from. When the cache goes over its size
+ * limit, least recently written images are removed.
+ * Cache is disabled if the size limit is 0.
+ */
+
+#include <QString>
+
+// Path where the decompressed copy of this image is kept
+QString decompressed_cache_path(const QString &file_name);
+
+// Returns md5 of the decompressed copy if there is a copy
+// that was made from the image with this md5, otherwise
+// returns an empty string
+QString decompressed_cache_md5(const QString &file_name, const QString &source_md5);
+
+// Marks the copy as recently used
+void decompressed_cache_touch(const QString &file_name);
+
+// Should be called before a write that makes a copy of
+// this image. Returns false if a copy of this image is
+// already being made by another write.
+bool decompressed_cache_start(const QString &file_name);
+
+// Should be called when the write that was making a copy
+// ends, successfully or not. Removes least recently used
+// copies until cache fits into its size limit.
+void decompressed_cache_finish(const QString &file_name);
+
+#endif // DECOMPRESSED_CACHE_H
@@ -299,7 +299,8 @@ Dialog {
                             id: messageDownload
                             visible: false
                             width: infoColumn.width
-                            text: qsTr("The file will be saved to your Downloads folder.")
+                            property string folder: releases.selected.variant.filePath.substring(0, releases.selected.variant.filePath.lastIndexOf("/"))
+                            text: qsTr("The file will be saved to %1.").arg(folder)
                         }
 
                         InfoMessage {
@@ -470,6 +471,15 @@ Dialog {
                             text: qsTr("Writing this image type is not supported.")
                             color: "red"
                         }
+                        Text {
+                            visible: drives.selected && releases.selected.variant.size > drives.selected.size
+                            font.pointSize: 10
+                            Layout.fillWidth: true
+                            width: Layout.width
+                            wrapMode: Text.WordWrap
+                            text: qsTr("This image is larger than the selected drive.")
+                            color: "red"
+                        }
                         Text {
                             visible: releases.selected.variant.noMd5sum
                             font.pointSize: 10
@@ -0,0 +1,363 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include "download_location.h"
+#include "image_files.h"
+#include "settings.h"
+
+#include <QAtomicInt>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSettings>
+#include <QStandardPaths>
+#include <QStorageInfo>
+#include <QThread>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#endif // Q_OS_UNIX
+
+#include <algorithm>
+
+// NOTE: leave some room so that the disk doesn't get
+// completely filled by the image
+static const qint64 free_space_margin = 1024L * 1024L * 1024L;
+static const qint64 benchmark_size = 32L * 1024L * 1024L;
+static const qint64 benchmark_chunk_size = 1024L * 1024L;
+// Disks don't change speed often, but they do get
+// replaced
+static const qint64 benchmark_max_age_secs = 30L * 24L * 60L * 60L;
+
+// Candidates sorted by speed, in default order until
+// benchmark finishes. Written by the benchmark thread.
+static QStringList sorted_dirs;
+static QMutex sorted_dirs_mutex;
+// Set when the app quits, so that it doesn't wait for
+// the whole benchmark
+static QAtomicInt benchmark_cancelled(0);
+
+static QStringList candidate_dirs();
+static QString find_downloaded(const QStringList &dirs, const QString &file_name, const bool check_disk);
+static QString existing_dir(const QString &dir);
+static qint64 benchmark_dir(const QString &dir);
+static void run_benchmark();
+static bool load_saved_ranking(const QStringList &dirs);
+static void save_ranking(const QStringList &dirs, const QStringList &sorted);
+
+QStringList download_location_dirs() {
+    QMutexLocker locker(&sorted_dirs_mutex);
+
+    if (sorted_dirs.isEmpty()) {
+        sorted_dirs = candidate_dirs();
+    }
+
+    return sorted_dirs;
+}
+
+QString download_location_for_file(const QString &file_name, const qint64 size) {
+    const QStringList dirs = download_location_dirs();
+
+    // NOTE: until download directories are listed for
+    // the first time, the disk is checked, so that an
+    // image isn't downloaded twice
+    const bool check_disk = !ImageFiles::instance()->scanned();
+    const QString downloaded_path = find_downloaded(dirs, file_name, check_disk);
+    if (!downloaded_path.isEmpty()) {
+        return downloaded_path;
+    }
+
+    for (const QString &dir : dirs) {
+        const QStorageInfo storage(existing_dir(dir));
+
+        if (storage.bytesAvailable() >= size + free_space_margin) {
+            // NOTE: cache folder might not exist yet, the
+            // watcher has to be told about it once it's
+            // created
+            QDir().mkpath(dir);
+            ImageFiles::instance()->watchDir(dir);
+
+            return QDir(dir).filePath(file_name);
+        }
+    }
+
+    // Nothing has enough space, download will fail with
+    // an error about that
+    return QDir(dirs.first()).filePath(file_name);
+}
+
+QString download_location_find_file(const QString &file_name) {
+    const QStringList dirs = download_location_dirs();
+
+    const QString downloaded_path = find_downloaded(dirs, file_name, false);
+    if (!downloaded_path.isEmpty()) {
+        return downloaded_path;
+    }
+
+    return QDir(dirs.first()).filePath(file_name);
+}
+
+// NOTE: ranking is saved, so the benchmark only runs
+// when the list of candidates changes or the ranking is
+// too old
+void download_location_benchmark() {
+    const bool loaded = load_saved_ranking(candidate_dirs());
+    if (loaded) {
+        return;
+    }
+
+    auto thread = new QThread();
+    auto worker = new QObject();
+    worker->moveToThread(thread);
+
+    QObject::connect(
+        thread, &QThread::started,
+        worker, [thread]() {
+            run_benchmark();
+            thread->quit();
+        });
+    QObject::connect(
+        thread, &QThread::finished,
+        worker, &QObject::deleteLater);
+    QObject::connect(
+        thread, &QThread::finished,
+        thread, &QObject::deleteLater);
+
+    // NOTE: thread has to be stopped before the
+    // application object is destroyed
+    QObject::connect(
+        qApp, &QCoreApplication::aboutToQuit,
+        thread, [thread]() {
+            benchmark_cancelled.store(1);
+            thread->quit();
+            thread->wait();
+        });
+
+    thread->start(QThread::LowestPriority);
+}
+
+// Downloads folder always comes first, so that it's used
+// if nothing is faster
+QStringList candidate_dirs() {
+    QStringList out;
+
+    const QStringList all_dirs = [&]() {
+        QStringList dirs;
+        dirs.append(QStandardPaths::writableLocation(QStandardPaths::DownloadLocation));
+        dirs.append(QStandardPaths::writableLocation(QStandardPaths::CacheLocation));
+        dirs.append(settings_download_dirs());
+
+        return dirs;
+    }();
+
+    for (const QString &dir : all_dirs) {
+        const QString clean_dir = QDir::cleanPath(dir);
+
+        if (clean_dir.isEmpty() || out.contains(clean_dir)) {
+            continue;
+        }
+
+        // NOTE: cache folder might not exist yet, then
+        // the filesystem that it would be created on is
+        // checked
+        const QStorageInfo storage(existing_dir(clean_dir));
+        const QByteArray fs_type = storage.fileSystemType();
+        const bool is_ram_fs = (fs_type == "tmpfs" || fs_type == "ramfs");
+
+        if (!storage.isValid() || storage.isReadOnly() || is_ram_fs) {
+            continue;
+        }
+
+        out.append(clean_dir);
+    }
+
+    if (out.isEmpty()) {
+        out.append(QStandardPaths::writableLocation(QStandardPaths::DownloadLocation));
+    }
+
+    return out;
+}
+
+// Returns path of the image if it's fully or partially
+// downloaded to one of the dirs, empty string otherwise
+QString find_downloaded(const QStringList &dirs, const QString &file_name, const bool check_disk) {
+    for (const QString &dir : dirs) {
+        const QString path = QDir(dir).filePath(file_name);
+
+        const bool exists = [&]() {
+            if (check_disk) {
+                return (QFile::exists(path) || QFile::exists(path + ".part"));
+            } else {
+                return (ImageFiles::instance()->exists(path) || ImageFiles::instance()->exists(path + ".part"));
+            }
+        }();
+
+        if (exists) {
+            return path;
+        }
+    }
+
+    return QString();
+}
+
+// Returns the directory or its closest parent that exists
+QString existing_dir(const QString &dir) {
+    QDir out(dir);
+
+    while (!out.exists() && !out.isRoot()) {
+        if (!out.cdUp()) {
+            break;
+        }
+    }
+
+    return out.path();
+}
+
+// Returns combined write and read speed of the directory
+// in bytes per second, 0 if it's not usable
+qint64 benchmark_dir(const QString &dir) {
+    QFile file(QDir(existing_dir(dir)).filePath(".altmediawriter-benchmark"));
+
+    const bool open_success = file.open(QIODevice::ReadWrite | QIODevice::Truncate);
+    if (!open_success) {
+        qDebug() << "Failed to open benchmark file in" << dir;
+
+        return 0;
+    }
+
+    const QByteArray chunk(benchmark_chunk_size, 'x');
+
+    QElapsedTimer timer;
+    timer.start();
+
+    for (qint64 written = 0; written < benchmark_size; written += chunk.size()) {
+        if (file.write(chunk) != chunk.size()) {
+            file.remove();
+
+            return 0;
+        }
+    }
+    file.flush();
+
+    // NOTE: without syncing and dropping the cache, this
+    // would only measure the speed of memory
+#ifdef Q_OS_UNIX
+    fsync(file.handle());
+#endif // Q_OS_UNIX
+
+#ifdef Q_OS_LINUX
+    posix_fadvise(file.handle(), 0, 0, POSIX_FADV_DONTNEED);
+#endif // Q_OS_LINUX
+
+    file.seek(0);
+    while (!file.atEnd()) {
+        if (file.read(benchmark_chunk_size).isEmpty()) {
+            break;
+        }
+    }
+
+    const qint64 elapsed = qMax((qint64) 1, timer.elapsed());
+
+    file.remove();
+
+    return benchmark_size * 2 * 1000 / elapsed;
+}
+
+void run_benchmark() {
+    const QStringList dirs = candidate_dirs();
+
+    const QHash<QString, qint64> speeds = [dirs]() {
+        QHash<QString, qint64> out;
+
+        for (const QString &dir : dirs) {
+            if (benchmark_cancelled.load() != 0) {
+                break;
+            }
+
+            out[dir] = benchmark_dir(dir);
+
+            qDebug() << "Download location" << dir << "speed is" << out[dir] << "bytes per second";
+        }
+
+        return out;
+    }();
+
+    QStringList sorted = dirs;
+    std::stable_sort(sorted.begin(), sorted.end(),
+        [speeds](const QString &a, const QString &b) {
+            return speeds[a] > speeds[b];
+        });
+
+    // Unusable directories are removed, unless there's
+    // nothing else
+    for (const QString &dir : dirs) {
+        if (speeds[dir] == 0 && sorted.size() > 1) {
+            sorted.removeAll(dir);
+        }
+    }
+
+    if (benchmark_cancelled.load() != 0) {
+        return;
+    }
+
+    save_ranking(dirs, sorted);
+
+    QMutexLocker locker(&sorted_dirs_mutex);
+    sorted_dirs = sorted;
+}
+
+// Returns true if there's a saved ranking for these
+// candidates that isn't too old
+bool load_saved_ranking(const QStringList &dirs) {
+    const QSettings settings;
+
+    const QStringList saved_dirs = settings.value("downloadLocation/dirs").toStringList();
+    const QStringList saved_sorted = settings.value("downloadLocation/sorted").toStringList();
+    const QDateTime saved_time = settings.value("downloadLocation/time").toDateTime();
+
+    const bool expired = (!saved_time.isValid() || saved_time.secsTo(QDateTime::currentDateTimeUtc()) > benchmark_max_age_secs);
+    if (saved_dirs != dirs || saved_sorted.isEmpty() || expired) {
+        return false;
+    }
+
+    qDebug() << "Using saved download location ranking" << saved_sorted;
+
+    QMutexLocker locker(&sorted_dirs_mutex);
+    sorted_dirs = saved_sorted;
+
+    return true;
+}
+
+void save_ranking(const QStringList &dirs, const QStringList &sorted) {
+    QSettings settings;
+    settings.setValue("downloadLocation/dirs", dirs);
+    settings.setValue("downloadLocation/sorted", sorted);
+    settings.setValue("downloadLocation/time", QDateTime::currentDateTimeUtc());
+}
@@ -0,0 +1,64 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef DOWNLOAD_LOCATION_H
+#define DOWNLOAD_LOCATION_H
+
+/*
+ * Images are downloaded to the fastest directory that has
+ * enough free space for them, so that both downloading
+ * and reading the image for writing go at full speed.
+ * Candidates are the Downloads folder, the cache folder
+ * and directories from the "downloadDirs" setting. Each
+ * candidate is assessed with a short sequential write
+ * and read on a separate thread. The ranking is saved
+ * and only measured again when the candidates change or
+ * the ranking gets old. Until the first measurement
+ * finishes, candidates are used in the order above.
+ * Directories on RAM filesystems are never used because
+ * images are too large for them.
+ */
+
+#include <QString>
+#include <QStringList>
+
+// All candidate directories, fastest first
+QStringList download_location_dirs();
+
+// Returns the path where the image should be downloaded.
+// If the image is already downloaded or partially
+// downloaded to one of the candidates, that path is
+// returned. Size can be 0 if it's unknown.
+QString download_location_for_file(const QString &file_name, const qint64 size);
+
+// Same as above but doesn't check free space or the
+// disk, only the list of downloaded files, even before
+// it's filled. For when the location is needed before
+// the download starts.
+QString download_location_find_file(const QString &file_name);
+
+// Measures speed of candidate directories on a separate
+// thread
+void download_location_benchmark();
+
+#endif // DOWNLOAD_LOCATION_H
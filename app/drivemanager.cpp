@@ -22,6 +22,7 @@
 
 #include "drivemanager.h"
 #include "progress.h"
+#include "throughput.h"
 #include "variant.h"
 
 #ifdef __linux__
@@ -261,6 +262,7 @@ Drive::Drive(DriveProvider *parent, const QString &name, const uint64_t size, co
         }
     }();
     m_variant = nullptr;
+    m_measureWrite = false;
 }
 
 Progress *Drive::progress() const {
@@ -300,13 +302,15 @@ Drive::RestoreStatus Drive::restoreStatus() {
 bool Drive::write(Variant *variant) {
     m_variant = variant;
     m_variant->setErrorString(QString());
+    m_measureWrite = (m_variant->status() == Variant::READY_FOR_WRITING && !m_variant->isCompressed());
 
     const QFile file(m_variant->filePath());
 
-    // TODO: this won't work for delayed write. When delayed
-    // write is turned on, this write() f-n is called and
-    // file size is not known yet.
-    if (file.size() > size()) {
+    // NOTE: when delayed write is turned on, the file
+    // doesn't exist yet, so use the size reported by the
+    // probe or the download
+    const qint64 image_size = qMax(file.size(), m_variant->size());
+    if (image_size > size()) {
         m_variant->setErrorString(tr("This drive is not large enough."));
         cancel();
         return false;
@@ -315,6 +319,30 @@ bool Drive::write(Variant *variant) {
     return true;
 }
 
+QIODevice *Drive::writeStream(Variant *variant) {
+    m_variant = variant;
+    m_measureWrite = false;
+    m_variant->setErrorString(tr("Writing without saving the image is not supported on this system."));
+
+    return nullptr;
+}
+
+void Drive::finishStream() {
+}
+
+void Drive::startWriteMeasurement() {
+    m_writeTimer.start();
+}
+
+void Drive::finishWriteMeasurement(const qint64 bytes) {
+    if (!m_measureWrite || !m_writeTimer.isValid()) {
+        return;
+    }
+
+    throughput_record_write(name(), bytes, m_writeTimer.elapsed());
+    m_writeTimer.invalidate();
+}
+
 void Drive::cancel() {
     m_error = QString();
     m_restoreStatus = CLEAN;
@@ -25,9 +25,12 @@
 
 #include <QAbstractListModel>
 #include <QDebug>
+#include <QElapsedTimer>
+#include <QPointer>
 
 class DriveManager;
 class DriveProvider;
+class QIODevice;
 class Drive;
 class UdisksDrive;
 class Progress;
@@ -170,6 +173,13 @@ public:
     virtual RestoreStatus restoreStatus();
 
     Q_INVOKABLE virtual bool write(Variant *variant);
+    // Starts writing an image that is passed to the
+    // returned device while it's being downloaded.
+    // Returns nullptr if that's not possible.
+    virtual QIODevice *writeStream(Variant *variant);
+    // Called when all of the image was passed to the
+    // stream
+    virtual void finishStream();
     Q_INVOKABLE virtual void cancel();
     Q_INVOKABLE virtual void restore() = 0;
 
@@ -182,12 +192,22 @@ signals:
     void restoreStatusChanged();
 
 protected:
-    Variant *m_variant;
+    // Measures write speed for estimates, only for
+    // uncompressed images that were fully downloaded
+    // before the write started
+    void startWriteMeasurement();
+    void finishWriteMeasurement(const qint64 bytes);
+
+    // NOTE: variant is deleted when it's removed from
+    // the catalog
+    QPointer<Variant> m_variant;
     Progress *m_progress;
     QString m_name;
     uint64_t m_size;
     RestoreStatus m_restoreStatus;
     QString m_error;
+    bool m_measureWrite;
+    QElapsedTimer m_writeTimer;
 };
 
 #endif // DRIVEMANAGER_H
@@ -0,0 +1,91 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include "icon_provider.h"
+#include "units.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QMutexLocker>
+
+// Enough for a few screens of releases at a couple of
+// sizes
+const int ICON_CACHE_SIZE_BYTES = 16 * 1024 * 1024;
+
+IconProvider::IconProvider()
+: QQuickImageProvider(QQuickImageProvider::Image) {
+    cache.setMaxCost(ICON_CACHE_SIZE_BYTES);
+}
+
+// NOTE: called from QML's image loading thread
+QImage IconProvider::requestImage(const QString &id, QSize *size, const QSize &requestedSize) {
+    const qreal pixel_ratio = Units::instance()->devicePixelRatio();
+
+    const QString key = QString("%1|%2x%3|%4").arg(id).arg(requestedSize.width()).arg(requestedSize.height()).arg(pixel_ratio);
+
+    QMutexLocker locker(&mutex);
+
+    const QImage image = [&]() {
+        const QImage *cached = cache.object(key);
+        if (cached != nullptr) {
+            return *cached;
+        }
+
+        const QImage original(":/logo/" + id);
+        if (original.isNull()) {
+            qDebug() << "Failed to load icon" << id;
+
+            return original;
+        }
+
+        const QImage out = [&]() {
+            if (!requestedSize.isValid()) {
+                return original;
+            }
+
+            const QSize scaled_size = requestedSize * pixel_ratio;
+            QImage scaled = original.scaled(scaled_size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+            scaled.setDevicePixelRatio(pixel_ratio);
+
+            return scaled;
+        }();
+
+        cache.insert(key, new QImage(out), out.byteCount());
+
+        return out;
+    }();
+
+    if (size != nullptr) {
+        *size = image.size();
+    }
+
+    return image;
+}
+
+bool IconProvider::exists(const QString &name) {
+    return QFile::exists(":/logo/" + name);
+}
+
+QString IconProvider::url(const QString &name) {
+    return "image://logo/" + name;
+}
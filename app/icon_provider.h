@@ -0,0 +1,59 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef ICON_PROVIDER_H
+#define ICON_PROVIDER_H
+
+/*
+ * IconProvider serves release icons to QML as
+ * "image://logo/<name>". Icons are decoded from
+ * resources and scaled to the requested size and the
+ * screen's pixel ratio once, then kept in memory, so
+ * that delegates that scroll back into view don't decode
+ * them again. Least recently used icons are dropped when
+ * the cache is full.
+ */
+
+#include <QCache>
+#include <QImage>
+#include <QMutex>
+#include <QQuickImageProvider>
+
+class IconProvider final : public QQuickImageProvider {
+public:
+    IconProvider();
+
+    QImage requestImage(const QString &id, QSize *size, const QSize &requestedSize) override;
+
+    // Returns whether there is an icon with this name
+    static bool exists(const QString &name);
+
+    // Url of the icon with this name, to be used in QML
+    static QString url(const QString &name);
+
+private:
+    QMutex mutex;
+    QCache<QString, QImage> cache;
+};
+
+#endif // ICON_PROVIDER_H
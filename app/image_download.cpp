@@ -19,6 +19,7 @@
 
 #include "image_download.h"
 #include "network.h"
+#include "throughput.h"
 
 #include <QDir>
 #include <QFile>
@@ -30,15 +31,30 @@
 #include <QStorageInfo>
 #include <QTimer>
 
-ImageDownload::ImageDownload(const QUrl &url_arg, const QString &filePath_arg, const QString &md5sum_arg)
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif // Q_OS_UNIX
+
+static qint64 process_cpu_msecs();
+
+ImageDownload::ImageDownload(const QUrl &url_arg, const QString &filePath_arg, const QString &md5sum_arg, const QList<QUrl> &peerUrls_arg)
 : QObject()
 , hash(QCryptographicHash::Md5) {
     url = url_arg;
+    peerUrls = peerUrls_arg;
     filePath = filePath_arg;
     md5sum = md5sum_arg;
     file = nullptr;
+    sink = nullptr;
+    streamReply = nullptr;
+    streamed = 0;
     startingImageDownload = false;
     wasCancelled = false;
+    peerDataUsed = false;
+    fileFollowed = false;
+    rateLimit = 0;
+    rateTimerPending = false;
+    replyStartSize = 0;
 
     qDebug() << this->metaObject()->className() << "created for" << url;
 
@@ -48,6 +64,50 @@ ImageDownload::ImageDownload(const QUrl &url_arg, const QString &filePath_arg, c
     file = new QFile(tempFilePath, this);
     file->open(QIODevice::WriteOnly | QIODevice::Append);
 
+    totalTimer.start();
+    totalStartSize = file->size();
+    cpuStart = process_cpu_msecs();
+
+    startImageDownload();
+}
+
+ImageDownload::ImageDownload(const QUrl &url_arg, QIODevice *sink_arg, const QString &md5sum_arg, const QList<QUrl> &peerUrls_arg)
+: QObject()
+, hash(QCryptographicHash::Md5) {
+    url = url_arg;
+    peerUrls = peerUrls_arg;
+    filePath = QString();
+    md5sum = md5sum_arg;
+    file = nullptr;
+    sink = sink_arg;
+    streamReply = nullptr;
+    streamed = 0;
+    startingImageDownload = false;
+    wasCancelled = false;
+    peerDataUsed = false;
+    fileFollowed = false;
+    rateLimit = 0;
+    rateTimerPending = false;
+    replyStartSize = 0;
+
+    qDebug() << this->metaObject()->className() << "created for" << url << "in stream mode";
+
+    totalTimer.start();
+    totalStartSize = 0;
+    cpuStart = process_cpu_msecs();
+
+    QNetworkProxyFactory::setUseSystemConfiguration(true);
+
+    // Continue passing data when the sink has room
+    // again. If the sink goes away, the writing process
+    // was cancelled or died.
+    connect(
+        sink_arg, &QIODevice::bytesWritten,
+        this, &ImageDownload::pumpStream);
+    connect(
+        sink_arg, &QObject::destroyed,
+        this, &ImageDownload::cancel);
+
     startImageDownload();
 }
 
@@ -72,16 +132,62 @@ void ImageDownload::cancel() {
     finish(ImageDownload::Cancelled);
 }
 
+void ImageDownload::setRateLimit(const qint64 bytes_per_second) {
+    rateLimit = bytes_per_second;
+
+    // NOTE: download is already started by the
+    // constructor, so apply to the current reply too
+    if (currentReply != nullptr) {
+        currentReply->setReadBufferSize(readBufferSize());
+    }
+}
+
+void ImageDownload::setFileFollowed() {
+    fileFollowed = true;
+}
+
+qint64 ImageDownload::readBufferSize() const {
+    // NOTE: 64MB buffer in case the user is on a very
+    // fast network. With a rate limit, the buffer is
+    // small so that the connection slows down too.
+    if (rateLimit > 0) {
+        return qMax((qint64) 256L * 1024L, rateLimit / 2);
+    } else {
+        return 64L * 1024L * 1024L;
+    }
+}
+
 void ImageDownload::onImageDownloadReadyRead() {
     QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
 
+    readReply(reply, false);
+}
+
+// NOTE: with a rate limit, data is read from the reply
+// only as fast as the limit allows. The rest waits in
+// the reply's small read buffer, so the connection itself
+// slows down. Drain reads everything regardless.
+// Returns false if the download was finished because of
+// an error.
+bool ImageDownload::readReply(QNetworkReply *reply, const bool drain) {
     if (startingImageDownload) {
         qDebug() << "Request started successfully";
         startingImageDownload = false;
 
+        // NOTE: in stream mode the sink already received
+        // the beginning of the image, so the server must
+        // continue at the requested offset instead of
+        // sending the whole image again
+        const int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        if (sink != nullptr && streamed > 0 && statusCode != 206) {
+            finish(ImageDownload::NetworkError, tr("The server doesn't support resuming the download."));
+
+            return false;
+        }
+
         const QVariant remainingSize = reply->header(QNetworkRequest::ContentLengthHeader);
         if (remainingSize.isValid()) {
-            const qint64 totalSize = file->size() + remainingSize.toULongLong();
+            const qint64 totalSize = downloadedSize() + remainingSize.toULongLong();
 
             emit progressMaxChanged(totalSize);
         }
@@ -89,7 +195,38 @@ void ImageDownload::onImageDownloadReadyRead() {
         emit started();
     }
 
-    const QByteArray data = reply->readAll();
+    if (sink != nullptr) {
+        pumpStream();
+
+        return true;
+    }
+
+    const qint64 read_size = [&]() {
+        if (rateLimit == 0 || drain) {
+            return reply->bytesAvailable();
+        }
+
+        const qint64 allowed = rateLimit * replyTimer.elapsed() / 1000 - (downloadedSize() - replyStartSize);
+
+        return qBound((qint64) 0, allowed, reply->bytesAvailable());
+    }();
+
+    const bool throttled = (read_size < reply->bytesAvailable());
+    if (throttled && !rateTimerPending) {
+        rateTimerPending = true;
+
+        const QPointer<QNetworkReply> reply_ptr = reply;
+        QTimer::singleShot(100, this,
+            [this, reply_ptr]() {
+                rateTimerPending = false;
+
+                if (reply_ptr != nullptr && !reply_ptr->isFinished()) {
+                    readReply(reply_ptr, false);
+                }
+            });
+    }
+
+    const QByteArray data = reply->read(read_size);
     if (reply->error() == QNetworkReply::NoError && data.size() > 0) {
         if (reply->header(QNetworkRequest::ContentLengthHeader).isValid()) {
             ;
@@ -98,31 +235,74 @@ void ImageDownload::onImageDownloadReadyRead() {
         const qint64 writeSize = file->write(data);
         const bool writeSuccess = (writeSize != -1);
         if (writeSuccess) {
+            if (!peerUrls.isEmpty()) {
+                peerDataUsed = true;
+            }
+
             emit progress(file->size());
         } else {
             QStorageInfo storage(file->fileName());
             const QString errorString = [storage]() {
                 if (storage.bytesAvailable() < 5L * 1024L * 1024L) {
-                    return tr("You ran out of space in your Downloads folder.");
+                    return tr("You ran out of space in %1.").arg(storage.rootPath());
                 } else {
                     return tr("The downloaded file is not writable.");
                 }
             }();
 
             finish(ImageDownload::DiskError, errorString);
+
+            return false;
         }
     }
+
+    return true;
 }
 
 void ImageDownload::onImageDownloadFinished() {
     QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
+
+    // NOTE: in stream mode reply may still contain data
+    // that didn't fit into the sink, stream finishes
+    // after it's passed on
+    if (!wasCancelled && sink != nullptr && reply->error() == QNetworkReply::NoError) {
+        pumpStream();
+
+        return;
+    }
+
+    // NOTE: rate limited download may leave data in the
+    // reply
+    if (!wasCancelled && file != nullptr && reply->error() == QNetworkReply::NoError) {
+        const bool read_success = readReply(reply, true);
+
+        if (!read_success) {
+            reply->deleteLater();
+
+            return;
+        }
+    }
+
     reply->deleteLater();
+    if (reply == streamReply) {
+        streamReply = nullptr;
+    }
 
     if (wasCancelled) {
         return;
+    } else if (reply->error() != QNetworkReply::NoError && !peerUrls.isEmpty()) {
+        // NOTE: peer failures are expected (peer is
+        // offline or doesn't have the image), so just
+        // move on to the next source without delay
+        qDebug() << "Failed to download from peer" << peerUrls.first() << reply->errorString();
+
+        peerUrls.removeFirst();
+        startImageDownload();
     } else if (reply->error() == QNetworkReply::NoError) {
         qDebug() << this->metaObject()->className() << "Finished successfully";
 
+        recordThroughput();
+
         if (md5sum.isEmpty()) {
             // If md5sum doesn't exist, be lenient and
             // don't treat this as a failed check.
@@ -177,6 +357,13 @@ void ImageDownload::computeMd5() {
                 qDebug() << "MD5 check passed";
 
                 rename_to_final_name();
+            } else if (peerDataUsed && !fileFollowed) {
+                // NOTE: a peer might have a broken or
+                // different copy, download the whole
+                // image again from the main url
+                qDebug() << "MD5 mismatch for image from a peer, downloading from" << url;
+
+                restartFromOrigin();
             } else {
                 qDebug() << "MD5 mismatch";
                 qDebug() << "sum should be =" << md5sum;
@@ -192,19 +379,166 @@ void ImageDownload::computeMd5() {
     }
 }
 
+// Pass data from reply to the sink, as much as the sink
+// can take without buffering too much in memory
+void ImageDownload::pumpStream() {
+    static const qint64 sink_buffer_max = 16L * 1024L * 1024L;
+    static const qint64 chunk_size = 4L * 1024L * 1024L;
+
+    if (wasCancelled || streamReply == nullptr) {
+        return;
+    }
+
+    if (sink == nullptr) {
+        finish(ImageDownload::DiskError, tr("The writing process has stopped."));
+
+        return;
+    }
+
+    while (sink->bytesToWrite() < sink_buffer_max && streamReply->bytesAvailable() > 0) {
+        const QByteArray data = streamReply->read(chunk_size);
+
+        const qint64 writeSize = sink->write(data);
+        if (writeSize != data.size()) {
+            finish(ImageDownload::DiskError, tr("The writing process has stopped."));
+
+            return;
+        }
+
+        hash.addData(data);
+        streamed += data.size();
+        emit progress(streamed);
+    }
+
+    const bool reply_drained = (streamReply->isFinished() && streamReply->bytesAvailable() == 0);
+    if (reply_drained && streamReply->error() == QNetworkReply::NoError) {
+        finishStream();
+    }
+}
+
+void ImageDownload::finishStream() {
+    qDebug() << this->metaObject()->className() << "Finished streaming";
+
+    recordThroughput();
+
+    if (md5sum.isEmpty()) {
+        qDebug() << this->metaObject()->className() << "No md5sum found, so skipping md5 check";
+
+        finish(ImageDownload::Success);
+
+        return;
+    }
+
+    const QByteArray sum_bytes = hash.result().toHex();
+    const QString computedMd5 = QString(sum_bytes);
+
+    if (computedMd5 == md5sum) {
+        qDebug() << "MD5 check passed";
+
+        finish(ImageDownload::Success);
+    } else {
+        qDebug() << "MD5 mismatch";
+        qDebug() << "sum should be =" << md5sum;
+        qDebug() << "computed sum  =" << computedMd5;
+
+        finish(ImageDownload::Md5CheckFail);
+    }
+}
+
+void ImageDownload::restartFromOrigin() {
+    peerUrls.clear();
+    peerDataUsed = false;
+    hash.reset();
+
+    file->close();
+    const bool open_success = file->open(QIODevice::WriteOnly | QIODevice::Truncate);
+    if (!open_success) {
+        finish(ImageDownload::DiskError, tr("The downloaded file is not writable."));
+
+        return;
+    }
+
+    totalStartSize = 0;
+    emit progress(0);
+
+    startImageDownload();
+}
+
+qint64 ImageDownload::downloadedSize() const {
+    if (sink != nullptr) {
+        return streamed;
+    } else {
+        return file->size();
+    }
+}
+
+// NOTE: peers are in the LAN, so their speed says
+// nothing about downloading from the internet. Speed of
+// a limited download says nothing either.
+void ImageDownload::recordThroughput() {
+    if (!peerUrls.isEmpty() || rateLimit > 0) {
+        return;
+    }
+
+    throughput_record_download(downloadedSize() - replyStartSize, replyTimer.elapsed());
+}
+
+// NOTE: time is counted until the image is verified, so
+// it includes the md5 check and pauses for resuming
+void ImageDownload::logStatistics() const {
+    const qint64 bytes = downloadedSize() - totalStartSize;
+    const double megabytes = bytes / (1024.0 * 1024.0);
+    const double seconds = qMax((qint64) 1, totalTimer.elapsed()) / 1000.0;
+
+    qDebug() << this->metaObject()->className() << "Downloaded" << megabytes << "MB, verified after" << seconds << "s," << (megabytes / seconds) << "MB/s";
+
+    const qint64 cpu_end = process_cpu_msecs();
+    if (cpuStart >= 0 && cpu_end >= 0 && megabytes > 0) {
+        qDebug() << this->metaObject()->className() << "Used" << ((cpu_end - cpuStart) / megabytes) << "ms of CPU time per MB";
+    }
+}
+
 void ImageDownload::startImageDownload() {
     qDebug() << this->metaObject()->className() << "startImageDownload()";
 
     startingImageDownload = true;
+    replyTimer.start();
+    replyStartSize = downloadedSize();
+
+    const bool from_peer = !peerUrls.isEmpty();
+    const QUrl request_url = [this, from_peer]() {
+        if (from_peer) {
+            return peerUrls.first();
+        } else {
+            return url;
+        }
+    }();
+
+    qDebug() << this->metaObject()->className() << "Downloading from" << request_url;
 
     QNetworkRequest request;
     request.setAttribute(QNetworkRequest::FollowRedirectsAttribute, true);
-    request.setUrl(url);
-    request.setRawHeader("Range", QString("bytes=%1-").arg(file->size()).toLocal8Bit());
+    request.setUrl(request_url);
+    request.setRawHeader("Range", QString("bytes=%1-").arg(downloadedSize()).toLocal8Bit());
 
     QNetworkReply *reply = network_access_manager->get(request);
-    // NOTE: 64MB buffer in case the user is on a very fast network
-    reply->setReadBufferSize(64L * 1024L * 1024L);
+    reply->setReadBufferSize(readBufferSize());
+    currentReply = reply;
+
+    if (sink != nullptr) {
+        streamReply = reply;
+    }
+
+    // Peers are in the LAN, so if one doesn't respond
+    // quickly, it's probably offline
+    if (from_peer) {
+        QTimer::singleShot(2000, reply,
+            [this, reply]() {
+                if (startingImageDownload) {
+                    reply->abort();
+                }
+            });
+    }
 
     connect(
         reply, &QNetworkReply::readyRead,
@@ -238,7 +572,23 @@ void ImageDownload::finish(const Result result_arg, const QString &errorString_a
         qDebug() << "Error string:" << m_errorString;
     }
 
-    if (m_result == ImageDownload::Success || m_result == ImageDownload::Cancelled) {
+    if (m_result == ImageDownload::Success) {
+        logStatistics();
+    }
+
+    if (file == nullptr) {
+        // Stream mode, stop the transfer if it's still
+        // going
+        if (sink != nullptr) {
+            disconnect(sink, nullptr, this, nullptr);
+        }
+        if (streamReply != nullptr) {
+            disconnect(streamReply, nullptr, this, nullptr);
+            streamReply->abort();
+            streamReply->deleteLater();
+            streamReply = nullptr;
+        }
+    } else if (m_result == ImageDownload::Success || m_result == ImageDownload::Cancelled) {
         file->close();
     } else {
         file->remove();
@@ -248,3 +598,21 @@ void ImageDownload::finish(const Result result_arg, const QString &errorString_a
 
     deleteLater();
 }
+
+// Returns CPU time used by the whole process, or -1 if
+// it's not available on this system
+qint64 process_cpu_msecs() {
+#ifdef Q_OS_UNIX
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return -1;
+    }
+
+    const qint64 user_msecs = usage.ru_utime.tv_sec * 1000 + usage.ru_utime.tv_usec / 1000;
+    const qint64 system_msecs = usage.ru_stime.tv_sec * 1000 + usage.ru_stime.tv_usec / 1000;
+
+    return user_msecs + system_msecs;
+#else
+    return -1;
+#endif // Q_OS_UNIX
+}
@@ -21,6 +21,7 @@
 #define IMAGE_DOWNLOAD_H
 
 #include <QCryptographicHash>
+#include <QElapsedTimer>
 #include <QObject>
 #include <QUrl>
 
@@ -39,9 +40,37 @@
  * finishes unsuccessfully, partially downloaded image is
  * deleted. Image download schedules itself for deletion
  * when it finishes.
+ *
+ * In stream mode the image is not saved. Downloaded data
+ * is passed to a sink device (the stdin of the writing
+ * helper) as it arrives and md5 is computed on the fly.
+ * Reading from the network is paused while the sink is
+ * backed up. Interrupted downloads resume at the exact
+ * offset that was passed to the sink.
+ *
+ * If peer urls are given, they are tried first. When a
+ * peer fails, the next one is tried and the download
+ * continues from the same offset. The main url is used
+ * after all peers failed. If an image that came from a
+ * peer fails the md5 check, it's downloaded again from
+ * the main url. In stream mode that's not possible
+ * because the data was already written. Same goes for a
+ * file that is followed by a delayed write, the write
+ * helper has already read the peer data. Such downloads
+ * fail with Md5CheckFail instead, which makes the write
+ * fail too because the partial file is deleted.
+ *
+ * A rate limit can be set for background downloads. Data
+ * is then read from the network no faster than the limit
+ * and the read buffer is kept small, so that the
+ * connection itself slows down.
  */
 
+#include <QPointer>
+
 class QFile;
+class QIODevice;
+class QNetworkReply;
 
 class ImageDownload final : public QObject {
     Q_OBJECT
@@ -51,13 +80,25 @@ public:
         Success,
         DiskError,
         Md5CheckFail,
+        NetworkError,
         Cancelled
     };
 
-    ImageDownload(const QUrl &url_arg, const QString &filePath_arg, const QString &md5sum_arg);
+    ImageDownload(const QUrl &url_arg, const QString &filePath_arg, const QString &md5sum_arg, const QList<QUrl> &peerUrls_arg = QList<QUrl>());
+
+    // Constructor for stream mode
+    ImageDownload(const QUrl &url_arg, QIODevice *sink_arg, const QString &md5sum_arg, const QList<QUrl> &peerUrls_arg = QList<QUrl>());
     Result result() const;
     QString errorString() const;
 
+    // Limits download speed in bytes per second, 0 for
+    // no limit. Only applies to downloads into a file.
+    void setRateLimit(const qint64 bytes_per_second);
+
+    // Tells that the partial file is being read while it
+    // grows, by a delayed write
+    void setFileFollowed();
+
 signals:
     // Emitted when download sucessfuly starts or resumes after being
     // interrupted.
@@ -87,21 +128,43 @@ private slots:
     void onImageDownloadReadyRead();
     void onImageDownloadFinished();
     void computeMd5();
+    void pumpStream();
 
 private:
     Result m_result;
     QString m_errorString;
 
     QUrl url;
+    QList<QUrl> peerUrls;
     QString filePath;
     QString md5sum;
     QFile *file;
+    QPointer<QIODevice> sink;
+    QNetworkReply *streamReply;
+    qint64 streamed;
     bool startingImageDownload;
     bool wasCancelled;
+    bool peerDataUsed;
+    bool fileFollowed;
+    qint64 rateLimit;
+    bool rateTimerPending;
+    QPointer<QNetworkReply> currentReply;
     QCryptographicHash hash;
+    QElapsedTimer replyTimer;
+    qint64 replyStartSize;
+    QElapsedTimer totalTimer;
+    qint64 totalStartSize;
+    qint64 cpuStart;
 
     QString getFilePath() const;
     void startImageDownload();
+    bool readReply(QNetworkReply *reply, const bool drain);
+    qint64 readBufferSize() const;
+    void restartFromOrigin();
+    qint64 downloadedSize() const;
+    void recordThroughput();
+    void logStatistics() const;
+    void finishStream();
     void rename_to_final_name();
     void finish(const Result result_arg, const QString &errorString_arg = QString());
 };
@@ -0,0 +1,206 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include "image_files.h"
+#include "download_location.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QThread>
+#include <QTimer>
+
+// NOTE: a download changes its directory many times,
+// changes are collected for a bit before listing the
+// directory again
+const int IMAGE_FILES_RESCAN_DELAY_MILLIS = 500;
+
+static QHash<QString, qint64> scan_dir(const QString &dir);
+
+ImageFiles *ImageFiles::_self = nullptr;
+
+ImageFiles *ImageFiles::instance() {
+    if (!_self) {
+        _self = new ImageFiles();
+    }
+    return _self;
+}
+
+ImageFiles::ImageFiles(QObject *parent)
+: QObject(parent) {
+    qRegisterMetaType<QHash<QString, qint64>>();
+
+    // Directories are listed on their own thread
+    auto thread = new QThread();
+    auto worker = new QObject();
+    worker->moveToThread(thread);
+
+    connect(
+        this, &ImageFiles::scanRequested,
+        worker, [this](const QString &dir) {
+            const QHash<QString, qint64> files = scan_dir(dir);
+            emit dirScanned(dir, files);
+        });
+    connect(
+        this, &ImageFiles::dirScanned,
+        this, &ImageFiles::onDirScanned);
+    connect(
+        thread, &QThread::finished,
+        worker, &QObject::deleteLater);
+    connect(
+        thread, &QThread::finished,
+        thread, &QObject::deleteLater);
+
+    // NOTE: thread has to be stopped before the
+    // application object is destroyed
+    connect(
+        qApp, &QCoreApplication::aboutToQuit,
+        thread, [thread]() {
+            thread->quit();
+            thread->wait();
+        });
+
+    thread->start(QThread::LowPriority);
+
+    rescanTimer = new QTimer(this);
+    rescanTimer->setSingleShot(true);
+    rescanTimer->setInterval(IMAGE_FILES_RESCAN_DELAY_MILLIS);
+    connect(
+        rescanTimer, &QTimer::timeout,
+        this, &ImageFiles::onRescanTimeout);
+
+    watchedDirs = download_location_dirs();
+
+    watcher = new QFileSystemWatcher(watchedDirs, this);
+    connect(
+        watcher, &QFileSystemWatcher::directoryChanged,
+        this, &ImageFiles::onDirChanged);
+
+    for (const QString &dir : watchedDirs) {
+        emit scanRequested(dir);
+    }
+}
+
+bool ImageFiles::exists(const QString &path) const {
+    return (size(path) != -1);
+}
+
+qint64 ImageFiles::size(const QString &path) const {
+    const QFileInfo info(path);
+    const QString dir = info.path();
+
+    // NOTE: the watcher ignores directories that don't
+    // exist, listings of such directories are not kept
+    // up to date
+    const bool watched = (watchedDirs.contains(dir) && watcher->directories().contains(dir));
+
+    if (watched) {
+        return dirs.value(dir).value(info.fileName(), -1);
+    }
+
+    if (info.exists()) {
+        return info.size();
+    } else {
+        return -1;
+    }
+}
+
+bool ImageFiles::scanned() const {
+    return (dirs.size() == watchedDirs.size());
+}
+
+void ImageFiles::watchDir(const QString &dir) {
+    if (watcher->directories().contains(dir)) {
+        return;
+    }
+
+    if (!watchedDirs.contains(dir)) {
+        watchedDirs.append(dir);
+    }
+
+    watcher->addPath(dir);
+    emit scanRequested(dir);
+}
+
+void ImageFiles::onDirChanged(const QString &dir) {
+    pendingDirs.insert(dir);
+
+    if (!rescanTimer->isActive()) {
+        rescanTimer->start();
+    }
+}
+
+void ImageFiles::onRescanTimeout() {
+    for (const QString &dir : pendingDirs) {
+        emit scanRequested(dir);
+    }
+
+    pendingDirs.clear();
+}
+
+void ImageFiles::onDirScanned(const QString &dir, const QHash<QString, qint64> &files) {
+    const QHash<QString, qint64> old_files = dirs.value(dir);
+
+    const QSet<QString> changed = [&]() {
+        QSet<QString> out;
+
+        for (auto it = files.begin(); it != files.end(); it++) {
+            const bool file_changed = (!old_files.contains(it.key()) || old_files[it.key()] != it.value());
+
+            if (file_changed) {
+                out.insert(it.key());
+            }
+        }
+
+        for (auto it = old_files.begin(); it != old_files.end(); it++) {
+            if (!files.contains(it.key())) {
+                out.insert(it.key());
+            }
+        }
+
+        return out;
+    }();
+
+    dirs[dir] = files;
+
+    if (!changed.isEmpty()) {
+        emit filesChanged(changed);
+    }
+}
+
+// Returns file name => size for all files in the
+// directory
+QHash<QString, qint64> scan_dir(const QString &dir) {
+    QHash<QString, qint64> out;
+
+    const QFileInfoList info_list = QDir(dir).entryInfoList(QDir::Files | QDir::Hidden);
+
+    for (const QFileInfo &info : info_list) {
+        out[info.fileName()] = info.size();
+    }
+
+    return out;
+}
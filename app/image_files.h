@@ -0,0 +1,98 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef IMAGE_FILES_H
+#define IMAGE_FILES_H
+
+/*
+ * ImageFiles keeps track of image files in download
+ * directories, so that checking whether an image is
+ * downloaded doesn't touch the disk. That matters when
+ * Downloads is on a network share, where every check can
+ * block the UI. Directories are listed on a separate
+ * thread at startup and again whenever the file system
+ * watcher (inotify on Linux) reports a change in them.
+ * Changes are announced so that images deleted or added
+ * outside of the app are noticed. Images are renamed to
+ * their final name only after they are verified, so a
+ * file under the final name is a verified image.
+ */
+
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+class QFileSystemWatcher;
+class QTimer;
+
+class ImageFiles final : public QObject {
+    Q_OBJECT
+
+public:
+    static ImageFiles *instance();
+
+    // Whether there is a file at this path. Paths
+    // outside of download directories and in directories
+    // that aren't watched are checked on disk. Files in directories that weren't listed yet
+    // are reported as missing, filesChanged() is emitted
+    // once they are listed.
+    bool exists(const QString &path) const;
+
+    // Size of the file at this path, -1 if there is no
+    // file
+    qint64 size(const QString &path) const;
+
+    // Whether all download directories were listed
+    bool scanned() const;
+
+    // Starts watching a download directory that was
+    // created after startup and lists it
+    void watchDir(const QString &dir);
+
+signals:
+    // Names of files that appeared, disappeared or
+    // changed size
+    void filesChanged(const QSet<QString> &file_names);
+
+    void scanRequested(const QString &dir);
+    void dirScanned(const QString &dir, const QHash<QString, qint64> &files);
+
+private:
+    explicit ImageFiles(QObject *parent = nullptr);
+
+    static ImageFiles *_self;
+    // Dir => file name => size
+    QHash<QString, QHash<QString, qint64>> dirs;
+    QStringList watchedDirs;
+    QFileSystemWatcher *watcher;
+    QSet<QString> pendingDirs;
+    QTimer *rescanTimer;
+
+    void onDirChanged(const QString &dir);
+    void onRescanTimeout();
+    void onDirScanned(const QString &dir, const QHash<QString, qint64> &files);
+};
+
+#endif // IMAGE_FILES_H
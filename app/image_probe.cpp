@@ -0,0 +1,116 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include "image_probe.h"
+#include "network.h"
+
+#include <QDebug>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QtEndian>
+
+// ISO 9660 volume descriptors start at sector 16, the
+// primary one comes first
+static const qint64 pvd_offset = 16 * 2048;
+static const qint64 pvd_length = 2048;
+
+ImageProbe::ImageProbe(const QUrl &url, QObject *parent)
+: QObject(parent) {
+    m_size = 0;
+    m_volumeSize = 0;
+    m_lastModified = QDateTime();
+
+    QNetworkRequest request(url);
+    request.setAttribute(QNetworkRequest::FollowRedirectsAttribute, true);
+    request.setRawHeader("Range", QString("bytes=%1-%2").arg(pvd_offset).arg(pvd_offset + pvd_length - 1).toLocal8Bit());
+
+    reply = makeNetworkRequest(request, 5000);
+
+    connect(
+        reply, &QNetworkReply::metaDataChanged,
+        this, &ImageProbe::onMetaDataChanged);
+    connect(
+        reply, &QNetworkReply::finished,
+        this, &ImageProbe::onFinished);
+}
+
+qint64 ImageProbe::size() const {
+    return m_size;
+}
+
+qint64 ImageProbe::volumeSize() const {
+    return m_volumeSize;
+}
+
+QDateTime ImageProbe::lastModified() const {
+    return m_lastModified;
+}
+
+void ImageProbe::onMetaDataChanged() {
+    const int status_code = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+
+    m_lastModified = reply->header(QNetworkRequest::LastModifiedHeader).toDateTime();
+
+    if (status_code == 206) {
+        // Content-Range: bytes 32768-34815/1234567890
+        // NOTE: total size can be "*" if it's unknown
+        const QString content_range = QString::fromLatin1(reply->rawHeader("Content-Range"));
+        const QString total = content_range.section('/', 1);
+
+        m_size = total.toLongLong();
+    } else if (status_code == 200) {
+        // Server ignored the range and is sending the
+        // whole image
+        m_size = reply->header(QNetworkRequest::ContentLengthHeader).toLongLong();
+
+        reply->abort();
+    }
+}
+
+void ImageProbe::onFinished() {
+    const int status_code = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+
+    if (reply->error() == QNetworkReply::NoError && status_code == 206) {
+        const QByteArray pvd = reply->readAll();
+
+        // Type 1 is the primary volume descriptor
+        const bool is_pvd = (pvd.size() == pvd_length && pvd.at(0) == 1 && pvd.mid(1, 5) == "CD001");
+
+        if (is_pvd) {
+            // NOTE: both fields are stored in both byte
+            // orders, little endian part comes first
+            const quint32 block_count = qFromLittleEndian<quint32>(pvd.constData() + 80);
+            const quint16 block_size = qFromLittleEndian<quint16>(pvd.constData() + 128);
+
+            m_volumeSize = (qint64) block_count * block_size;
+        }
+    } else if (reply->error() != QNetworkReply::NoError && m_size == 0) {
+        qDebug() << this->metaObject()->className() << "Failed to probe" << reply->url() << reply->errorString();
+    }
+
+    reply->deleteLater();
+
+    emit finished();
+
+    deleteLater();
+}
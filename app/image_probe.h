@@ -0,0 +1,70 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef IMAGE_PROBE_H
+#define IMAGE_PROBE_H
+
+/*
+ * Image probe finds out the size of a remote image
+ * before it's downloaded. A single small range request
+ * is made for the part of the image that contains the
+ * ISO primary volume descriptor. The response headers
+ * give the total size and modification time of the
+ * image and, if the image is an ISO, the descriptor
+ * gives the size of the volume. If the server ignores
+ * the range, the request is aborted as soon as the
+ * headers arrive. Image probe schedules itself for
+ * deletion when it finishes.
+ */
+
+#include <QDateTime>
+#include <QObject>
+#include <QUrl>
+
+class QNetworkReply;
+
+class ImageProbe final : public QObject {
+    Q_OBJECT
+
+public:
+    ImageProbe(const QUrl &url, QObject *parent);
+
+    // Sizes are 0 if they couldn't be determined
+    qint64 size() const;
+    qint64 volumeSize() const;
+    QDateTime lastModified() const;
+
+signals:
+    void finished();
+
+private:
+    QNetworkReply *reply;
+    qint64 m_size;
+    qint64 m_volumeSize;
+    QDateTime m_lastModified;
+
+    void onMetaDataChanged();
+    void onFinished();
+};
+
+#endif // IMAGE_PROBE_H
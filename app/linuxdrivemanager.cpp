@@ -21,7 +21,9 @@
  */
 
 #include "linuxdrivemanager.h"
+#include "decompressed_cache.h"
 #include "progress.h"
+#include "settings.h"
 #include "variant.h"
 
 #include <QDBusArgument>
@@ -187,6 +189,8 @@ LinuxDrive::LinuxDrive(LinuxDriveProvider *parent, const QString &device, const
 : Drive(parent, name, size, isoLayout) {
     m_device = device;
     m_process = nullptr;
+    m_imagePath = QString();
+    m_cachingFile = QString();
 }
 
 LinuxDrive::~LinuxDrive() {
@@ -203,6 +207,77 @@ bool LinuxDrive::write(Variant *variant) {
         return false;
     }
 
+    // NOTE: md5 of the compressed image is needed to
+    // check that the decompressed copy was made from the
+    // same image
+    const bool use_cache = (settings_decompressed_cache_size() > 0 && variant->isCompressed() && !variant->md5sum().isEmpty());
+    const QString cached_md5 = [&]() {
+        if (use_cache) {
+            return decompressed_cache_md5(variant->fileName(), variant->md5sum());
+        } else {
+            return QString();
+        }
+    }();
+
+    QStringList args;
+    args << "write";
+
+    if (!cached_md5.isEmpty()) {
+        m_imagePath = decompressed_cache_path(variant->fileName());
+        decompressed_cache_touch(variant->fileName());
+
+        qDebug() << this->metaObject()->className() << "Writing decompressed copy" << m_imagePath;
+
+        args << m_imagePath;
+        args << m_device;
+        args << cached_md5;
+    } else {
+        m_imagePath = variant->filePath();
+
+        args << m_imagePath;
+        args << m_device;
+        args << variant->md5sum();
+
+        if (use_cache && decompressed_cache_start(variant->fileName())) {
+            m_cachingFile = variant->fileName();
+            args << decompressed_cache_path(variant->fileName());
+        }
+    }
+
+    return startWriteHelper(args, QIODevice::ReadOnly);
+}
+
+QIODevice *LinuxDrive::writeStream(Variant *variant) {
+    qDebug() << this->metaObject()->className() << "Will now stream" << variant->fileName() << "to" << this->m_device;
+
+    m_variant = variant;
+    m_variant->setErrorString(QString());
+    m_imagePath = variant->filePath();
+
+    // NOTE: image data is passed to helper's stdin, file
+    // name is only needed to detect compression
+    QStringList args;
+    args << "stream";
+    args << variant->fileName();
+    args << m_device;
+    args << variant->md5sum();
+
+    const bool start_success = startWriteHelper(args, QIODevice::ReadWrite);
+
+    if (start_success) {
+        return m_process;
+    } else {
+        return nullptr;
+    }
+}
+
+void LinuxDrive::finishStream() {
+    if (m_process != nullptr) {
+        m_process->closeWriteChannel();
+    }
+}
+
+bool LinuxDrive::startWriteHelper(const QStringList &args, const QIODevice::OpenMode mode) {
     if (!m_process) {
         m_process = new QProcess(this);
     }
@@ -211,17 +286,11 @@ bool LinuxDrive::write(Variant *variant) {
     if (!helperPath.isEmpty()) {
         m_process->setProgram(helperPath);
     } else {
-        variant->setErrorString(tr("Could not find the helper binary. Check your installation."));
-        variant->setStatus(Variant::WRITING_FAILED);
+        m_variant->setErrorString(tr("Could not find the helper binary. Check your installation."));
+        m_variant->setStatus(Variant::WRITING_FAILED);
         return false;
     }
 
-    QStringList args;
-    args << "write";
-    args << variant->filePath();
-    args << m_device;
-    args << variant->md5sum();
-
     qDebug() << this->metaObject()->className() << "Helper command will be" << args;
     m_process->setArguments(args);
 
@@ -232,13 +301,14 @@ bool LinuxDrive::write(Variant *variant) {
     connect(m_process, &QProcess::errorOccurred, this, &LinuxDrive::onErrorOccurred);
 #endif
 
-    m_process->start(QIODevice::ReadOnly);
+    m_process->start(mode);
 
     return true;
 }
 
 void LinuxDrive::cancel() {
     Drive::cancel();
+    finishCaching();
     static bool beingCancelled = false;
     if (m_process != nullptr && !beingCancelled) {
         beingCancelled = true;
@@ -296,19 +366,20 @@ void LinuxDrive::onReadyRead() {
         qDebug() << "helper:" << line;
         if (line == "WRITE") {
             // Set progress bar max value at start of writing
-            const QFile file(m_variant->filePath());
-            m_progress->setMax(file.size());
+            m_progress->setMax(imageSize());
 
             m_progress->setCurrent(0);
 
             m_variant->setStatus(Variant::WRITING);
+            startWriteMeasurement();
         } else if (line == "CHECK") {
             qDebug() << this->metaObject()->className() << "Helper finished writing, now it will check the written data";
-            const QFile file(m_variant->filePath());
-            m_progress->setMax(file.size());
+            finishWriteMeasurement(imageSize());
+            m_progress->setMax(imageSize());
             m_progress->setCurrent(0);
             m_variant->setStatus(Variant::WRITE_VERIFYING);
         } else if (line == "DONE") {
+            finishWriteMeasurement(imageSize());
             m_variant->setStatus(Variant::WRITING_FINISHED);
             Notifications::notify(tr("Finished!"), tr("Writing %1 was successful").arg(m_variant->fileName()));
         } else {
@@ -328,6 +399,8 @@ void LinuxDrive::onFinished(const int exitCode, const QProcess::ExitStatus statu
         return;
     }
 
+    finishCaching();
+
     if (exitCode != 0) {
         QString errorMessage = m_process->readAllStandardError();
         qDebug() << "Writing failed:" << errorMessage;
@@ -386,6 +459,25 @@ void LinuxDrive::onErrorOccurred(const QProcess::ProcessError e) {
     m_variant = nullptr;
 }
 
+// NOTE: streamed images don't exist on disk, their size
+// is known from the download
+qint64 LinuxDrive::imageSize() const {
+    const QFile file(m_imagePath);
+
+    if (file.exists()) {
+        return file.size();
+    } else {
+        return m_variant->size();
+    }
+}
+
+void LinuxDrive::finishCaching() {
+    if (!m_cachingFile.isEmpty()) {
+        decompressed_cache_finish(m_cachingFile);
+        m_cachingFile = QString();
+    }
+}
+
 QString LinuxDrive::devicePath() const {
     QString deviceName = m_device.mid(m_device.lastIndexOf("/"));
     return "/dev" + deviceName;
@@ -68,6 +68,8 @@ public:
     ~LinuxDrive();
 
     Q_INVOKABLE virtual bool write(Variant *variant) override;
+    virtual QIODevice *writeStream(Variant *variant) override;
+    virtual void finishStream() override;
     Q_INVOKABLE virtual void cancel() override;
     Q_INVOKABLE virtual void restore() override;
 
@@ -83,6 +85,12 @@ private:
     QString m_device;
 
     QProcess *m_process;
+    QString m_imagePath;
+    QString m_cachingFile;
+
+    bool startWriteHelper(const QStringList &args, const QIODevice::OpenMode mode);
+    qint64 imageSize() const;
+    void finishCaching();
 };
 
 #endif // LINUXDRIVEMANAGER_H
@@ -20,11 +20,18 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
+#include "download_location.h"
 #include "drivemanager.h"
+#include "icon_provider.h"
+#include "image_files.h"
+#include "peer_cache.h"
 #include "progress.h"
 #include "release.h"
 #include "release_model.h"
 #include "releasemanager.h"
+#include "settings.h"
+#include "throughput.h"
+#include "trace.h"
 #include "variant.h"
 #include "units.h"
 
@@ -100,8 +107,12 @@ int main(int argc, char **argv) {
 
     qInstallMessageHandler(myMessageOutput);
 
+    trace_init();
+
     QApplication::setAttribute(Qt::AA_UseHighDpiPixmaps);
+    const qint64 app_start_time = trace_now();
     QApplication app(argc, argv);
+    trace_span("Construct application", "startup", app_start_time);
 
     qDebug() << "Application constructed";
 
@@ -111,12 +122,23 @@ int main(int argc, char **argv) {
     translator.load(QLocale(QLocale().language(), QLocale().country()), QString(), QString(), ":/translations");
     app.installTranslator(&translator);
 
+    if (settings_peer_cache_serve()) {
+        new PeerCacheServer(download_location_dirs(), settings_peer_cache_port(), &app);
+    }
+
     qDebug() << "Injecting QML context properties";
     QQmlApplicationEngine engine;
+    throughput_benchmark_decompress();
+    download_location_benchmark();
+    ImageFiles::instance();
+
     engine.rootContext()->setContextProperty("drives", DriveManager::instance());
+    const qint64 release_manager_start_time = trace_now();
     engine.rootContext()->setContextProperty("releases", new ReleaseManager());
+    trace_span("Construct release manager", "startup", release_manager_start_time);
     engine.rootContext()->setContextProperty("mediawriterVersion", MEDIAWRITER_VERSION);
     engine.rootContext()->setContextProperty("units", Units::instance());
+    engine.addImageProvider("logo", new IconProvider());
 
     qmlRegisterUncreatableType<ReleaseFilterModel>("MediaWriter", 1, 0, "ReleaseFilterModel", "");
     qmlRegisterUncreatableType<Release>("MediaWriter", 1, 0, "Release", "");
@@ -125,7 +147,9 @@ int main(int argc, char **argv) {
     qmlRegisterUncreatableType<Drive>("MediaWriter", 1, 0, "Drive", "");
 
     qDebug() << "Loading the QML source code";
+    const qint64 load_start_time = trace_now();
     engine.load(QUrl(QStringLiteral("qrc:/main.qml")));
+    trace_span("Load QML", "startup", load_start_time);
 
     qDebug() << "Starting the application";
     int status = app.exec();
@@ -0,0 +1,142 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include "md5sum_fetcher.h"
+#include "catalog.h"
+#include "metadata_cache.h"
+#include "network.h"
+#include "variant.h"
+
+#include <QDebug>
+#include <QNetworkReply>
+#include <QUrl>
+
+QString md5sum_url_for_variant(const Variant *variant);
+
+Md5sumFetcher *Md5sumFetcher::_self = nullptr;
+
+Md5sumFetcher *Md5sumFetcher::instance() {
+    if (!_self) {
+        _self = new Md5sumFetcher();
+    }
+    return _self;
+}
+
+Md5sumFetcher::Md5sumFetcher(QObject *parent)
+: QObject(parent) {
+
+}
+
+void Md5sumFetcher::fetch(Variant *variant) {
+    const QString url = md5sum_url_for_variant(variant);
+
+    if (manifests.contains(url)) {
+        variant->setMd5sum(manifests[url].value(variant->fileName()));
+
+        return;
+    }
+
+    // NOTE: there are multiple images per folder, so
+    // only one request is made for all of them
+    const bool already_requested = waiting.contains(url);
+
+    if (!waiting[url].contains(variant)) {
+        waiting[url].append(variant);
+    }
+
+    if (already_requested) {
+        return;
+    }
+
+    auto group = new NetworkReplyGroup({url}, this);
+    connect(
+        group, &NetworkReplyGroup::reply_finished,
+        this, &Md5sumFetcher::onReplyFinished);
+}
+
+void Md5sumFetcher::clear() {
+    manifests.clear();
+
+    emit cleared();
+}
+
+void Md5sumFetcher::onReplyFinished(const QString &url) {
+    auto group = qobject_cast<NetworkReplyGroup *>(sender());
+    QNetworkReply *reply = group->get_reply_list()[url];
+
+    const QNetworkReply::NetworkError error = reply->error();
+
+    // NOTE: missing MD5SUM means that images in that
+    // folder are not checked. On other errors the
+    // cached copy is used, if there is one, and the
+    // download is tried again next time.
+    const QByteArray cached_bytes = [&]() {
+        if (error != QNetworkReply::NoError && error != QNetworkReply::ContentNotFoundError) {
+            qDebug() << "Failed to download md5sum:" << reply->errorString() << reply->error();
+
+            return metadata_cache_get(url);
+        } else {
+            return QByteArray();
+        }
+    }();
+    const bool failed = (error != QNetworkReply::NoError && error != QNetworkReply::ContentNotFoundError && cached_bytes.isEmpty());
+
+    const QHash<QString, QString> manifest = [&]() {
+        if (error == QNetworkReply::NoError) {
+            const QByteArray bytes = metadata_cache_read(reply);
+            const QHash<QString, QString> out = catalog_parse_md5sum(bytes);
+            manifests[url] = out;
+
+            return out;
+        } else if (error == QNetworkReply::ContentNotFoundError) {
+            manifests[url] = QHash<QString, QString>();
+
+            return QHash<QString, QString>();
+        } else {
+            return catalog_parse_md5sum(cached_bytes);
+        }
+    }();
+
+    const QList<QPointer<Variant>> variant_list = waiting.take(url);
+    for (const QPointer<Variant> &variant : variant_list) {
+        if (variant == nullptr) {
+            continue;
+        }
+
+        if (failed) {
+            variant->setMd5sumFailed();
+        } else {
+            variant->setMd5sum(manifest.value(variant->fileName()));
+        }
+    }
+
+    group->deleteLater();
+}
+
+// Images in a folder share one MD5SUM file
+QString md5sum_url_for_variant(const Variant *variant) {
+    const QUrl url(variant->url());
+    const QString out = url.adjusted(QUrl::RemoveFilename).toString() + "/MD5SUM";
+
+    return out;
+}
@@ -0,0 +1,75 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef MD5SUM_FETCHER_H
+#define MD5SUM_FETCHER_H
+
+/*
+ * Md5sumFetcher gets md5sums of images on demand. Each
+ * directory with images has an MD5SUM file, it is
+ * downloaded the first time an image from that directory
+ * is selected or downloaded. Downloaded MD5SUM's are kept
+ * in memory and in the metadata cache, so that other
+ * images from the same directory don't need another
+ * request. Only a missing MD5SUM means that images have
+ * no md5sum. If MD5SUM couldn't be downloaded for other
+ * reasons and it's not in the cache either, variants
+ * are told that it failed and can try again later.
+ */
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QPointer>
+
+class Variant;
+
+class Md5sumFetcher final : public QObject {
+    Q_OBJECT
+
+public:
+    static Md5sumFetcher *instance();
+
+    // Sets variant's md5sum once it's known
+    void fetch(Variant *variant);
+
+    // Forgets downloaded MD5SUM's so that they are
+    // downloaded again when needed. Variants reset their
+    // md5sums on cleared().
+    void clear();
+
+signals:
+    void cleared();
+
+private:
+    explicit Md5sumFetcher(QObject *parent = nullptr);
+
+    static Md5sumFetcher *_self;
+    // MD5SUM url => image name => md5sum
+    QHash<QString, QHash<QString, QString>> manifests;
+    QHash<QString, QList<QPointer<Variant>>> waiting;
+
+    void onReplyFinished(const QString &url);
+};
+
+#endif // MD5SUM_FETCHER_H
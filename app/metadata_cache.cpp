@@ -0,0 +1,209 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include "metadata_cache.h"
+
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QStandardPaths>
+#include <QUrl>
+
+// NOTE: built-in files are named the same way as files
+// in the cache, see dist/catalog/update_catalog.sh
+const QString BUILTIN_DIR = ":/catalog";
+
+static QString cache_dir();
+static QString path_for_url(const QString &url);
+static QString url_hash(const QString &url);
+static MetadataSnapshot read_snapshot(const QString &path);
+static bool write_file(const QString &path, const QByteArray &contents);
+
+void metadata_cache_prepare_request(QNetworkRequest *request) {
+    const QString path = path_for_url(request->url().toString());
+
+    QFile headers_file(path + ".headers");
+    const bool open_success = headers_file.open(QIODevice::ReadOnly);
+    if (!open_success || !QFile::exists(path)) {
+        return;
+    }
+
+    // First line is ETag, second is Last-Modified, either
+    // can be empty
+    const QList<QByteArray> headers = headers_file.readAll().split('\n');
+
+    if (headers.size() >= 1 && !headers[0].isEmpty()) {
+        request->setRawHeader("If-None-Match", headers[0]);
+    }
+    if (headers.size() >= 2 && !headers[1].isEmpty()) {
+        request->setRawHeader("If-Modified-Since", headers[1]);
+    }
+}
+
+QByteArray metadata_cache_read(QNetworkReply *reply) {
+    const QString url = reply->request().url().toString();
+    const int status_code = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+
+    if (status_code == 304) {
+        return metadata_cache_get(url);
+    }
+
+    const QByteArray contents = reply->readAll();
+
+    if (reply->error() == QNetworkReply::NoError) {
+        const QString path = path_for_url(url);
+        const QByteArray headers = reply->rawHeader("ETag") + "\n" + reply->rawHeader("Last-Modified");
+
+        const bool write_success = (write_file(path, contents) && write_file(path + ".headers", headers));
+        if (!write_success) {
+            qDebug() << "Failed to save" << url << "to metadata cache";
+        }
+    }
+
+    return contents;
+}
+
+QByteArray metadata_cache_get(const QString &url) {
+    QFile file(path_for_url(url));
+
+    const bool open_success = file.open(QIODevice::ReadOnly);
+    if (!open_success) {
+        return QByteArray();
+    }
+
+    return file.readAll();
+}
+
+// NOTE: snapshot is a list of lines like "image <url>"
+void metadata_cache_save_snapshot(const MetadataSnapshot &snapshot) {
+    QByteArray contents;
+
+    const QList<QPair<QByteArray, QList<QString>>> groups = {
+        {"section", snapshot.section_urls},
+        {"image", snapshot.image_urls},
+    };
+
+    for (const auto &group : groups) {
+        for (const QString &url : group.second) {
+            contents += group.first + " " + url.toUtf8() + "\n";
+        }
+    }
+
+    write_file(QDir(cache_dir()).filePath("snapshot"), contents);
+}
+
+MetadataSnapshot metadata_cache_load_snapshot() {
+    return read_snapshot(QDir(cache_dir()).filePath("snapshot"));
+}
+
+MetadataSnapshot metadata_cache_load_builtin_snapshot() {
+    return read_snapshot(QDir(BUILTIN_DIR).filePath("snapshot"));
+}
+
+QByteArray metadata_cache_get_builtin(const QString &url) {
+    QFile file(QDir(BUILTIN_DIR).filePath(url_hash(url)));
+
+    const bool open_success = file.open(QIODevice::ReadOnly);
+    if (!open_success) {
+        return QByteArray();
+    }
+
+    return file.readAll();
+}
+
+MetadataSnapshot read_snapshot(const QString &path) {
+    QFile file(path);
+
+    const bool open_success = file.open(QIODevice::ReadOnly);
+    if (!open_success) {
+        return MetadataSnapshot();
+    }
+
+    MetadataSnapshot out;
+
+    const QList<QByteArray> lines = file.readAll().split('\n');
+    for (const QByteArray &line : lines) {
+        const int space_index = line.indexOf(' ');
+        if (space_index == -1) {
+            continue;
+        }
+
+        const QByteArray group = line.left(space_index);
+        const QString url = QString::fromUtf8(line.mid(space_index + 1));
+
+        if (group == "section") {
+            out.section_urls.append(url);
+        } else if (group == "image") {
+            out.image_urls.append(url);
+        }
+    }
+
+    return out;
+}
+
+QString cache_dir() {
+    const QString out = QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath("metadata");
+    QDir().mkpath(out);
+
+    return out;
+}
+
+QString path_for_url(const QString &url) {
+    return QDir(cache_dir()).filePath(url_hash(url));
+}
+
+// NOTE: url is normalized because replies return it in
+// normalized form
+QString url_hash(const QString &url) {
+    const QString normalized_url = QUrl(url).toString();
+    const QByteArray hash = QCryptographicHash::hash(normalized_url.toUtf8(), QCryptographicHash::Md5).toHex();
+
+    return QString(hash);
+}
+
+// NOTE: write to a temporary file first so that an
+// interrupted write doesn't leave a truncated copy
+bool write_file(const QString &path, const QByteArray &contents) {
+    QFile file(path + ".tmp");
+
+    const bool open_success = file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    if (!open_success) {
+        return false;
+    }
+
+    const bool write_success = (file.write(contents) == contents.size());
+    file.close();
+
+    if (!write_success) {
+        file.remove();
+
+        return false;
+    }
+
+    QFile::remove(path);
+
+    return file.rename(path);
+}
@@ -0,0 +1,77 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef METADATA_CACHE_H
+#define METADATA_CACHE_H
+
+/*
+ * Metadata cache keeps the last downloaded copy of every
+ * metadata file, together with its ETag and Last-Modified
+ * headers. Requests for metadata carry them as
+ * If-None-Match and If-Modified-Since, so that servers
+ * can answer with "304 Not Modified" instead of sending
+ * the file again. The cache also remembers which files
+ * made up the last complete catalog, so that the catalog
+ * can be shown right away on the next start, even when
+ * offline. On the first start, there is a snapshot of
+ * the catalog that is built into the app, if it was
+ * built with one.
+ */
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+class QNetworkReply;
+class QNetworkRequest;
+
+struct MetadataSnapshot {
+    QList<QString> section_urls;
+    QList<QString> image_urls;
+};
+
+// Adds conditional headers for the cached copy of the
+// requested url, if there is one
+void metadata_cache_prepare_request(QNetworkRequest *request);
+
+// Returns contents of a finished reply. If the server
+// replied that the file wasn't modified, returns the
+// cached copy. New contents are saved to the cache.
+QByteArray metadata_cache_read(QNetworkReply *reply);
+
+// Returns the cached copy of the file at this url, or
+// an empty array if it's not cached
+QByteArray metadata_cache_get(const QString &url);
+
+void metadata_cache_save_snapshot(const MetadataSnapshot &snapshot);
+
+// Returns an empty snapshot if there is none. Files that
+// failed to download when the snapshot was made are
+// empty.
+MetadataSnapshot metadata_cache_load_snapshot();
+
+// Same as above for the built-in snapshot
+MetadataSnapshot metadata_cache_load_builtin_snapshot();
+QByteArray metadata_cache_get_builtin(const QString &url);
+
+#endif // METADATA_CACHE_H
@@ -21,54 +21,143 @@
  */
 
 #include "network.h"
+#include "metadata_cache.h"
+#include "trace.h"
 
+#include <QDebug>
+#include <QJsonObject>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
+#include <QSharedPointer>
 #include <QTimer>
 
+#include <random>
+
 QNetworkAccessManager *network_access_manager = new QNetworkAccessManager();
 
-NetworkReplyGroup::NetworkReplyGroup(const QList<QString> &url_list, QObject *parent)
-: QObject(parent) {
-    reply_list = [&]() {
-        QHash<QString, QNetworkReply *> out;
-        for (const QString &url : url_list) {
-            QNetworkReply *reply = makeNetworkRequest(url, 5000);
+static const int attempt_time_out_millis = 5000;
+static const int attempts_max = 4;
+static const int retry_delay_min_millis = 500;
+static const int retry_delay_max_millis = 8000;
+// Requests are not retried after this
+static const qint64 deadline_millis = 30000;
 
-            out[url] = reply;
-        }
+static bool error_is_temporary(const QNetworkReply::NetworkError error);
 
-        return out;
-    }();
+static int active_request_count = 0;
 
-    for (QNetworkReply *reply : reply_list) {
-        connect(
-            reply, &QNetworkReply::finished,
-            this, &NetworkReplyGroup::on_reply_finished);
+NetworkReplyGroup::NetworkReplyGroup(const QList<QString> &url_list, QObject *parent)
+: QObject(parent) {
+    for (const QString &url : url_list) {
+        add(url);
     }
 }
 
 NetworkReplyGroup::~NetworkReplyGroup() {
     // NOTE: network replies have to be deleted using
     // deleteLater(), deleting using normal delete
-    // causes problems
+    // causes problems. Replies that are still running
+    // are aborted first, otherwise they never emit
+    // finished().
     for (QNetworkReply *reply : reply_list) {
+        reply->disconnect(this);
+        if (reply->isRunning()) {
+            reply->abort();
+        }
         reply->deleteLater();
     }
 }
 
+// Adds a request to the group after it was created,
+// does nothing if this url was already requested
+void NetworkReplyGroup::add(const QString &url) {
+    if (reply_list.contains(url)) {
+        return;
+    }
+
+    attempt_count[url] = 0;
+    elapsed_timers[url].start();
+
+    start_request(url);
+}
+
 QHash<QString, QNetworkReply *> NetworkReplyGroup::get_reply_list() const {
     return reply_list;
 }
 
-// Emit finished() signal when all requests are
-// finished
-void NetworkReplyGroup::on_reply_finished() {
+void NetworkReplyGroup::start_request(const QString &url) {
+    // NOTE: reply groups are only used for
+    // metadata, which is cached
+    QNetworkRequest request(url);
+    request.setAttribute(QNetworkRequest::FollowRedirectsAttribute, true);
+    metadata_cache_prepare_request(&request);
+
+    QNetworkReply *reply = makeNetworkRequest(request, attempt_time_out_millis);
+
+    if (reply_list.contains(url)) {
+        reply_list[url]->deleteLater();
+    }
+    reply_list[url] = reply;
+    attempt_count[url]++;
+    trace_start_times[url] = trace_now();
+
+    connect(
+        reply, &QNetworkReply::finished,
+        this, [this, url, reply]() {
+            on_reply_finished(url, reply);
+        });
+}
+
+void NetworkReplyGroup::on_reply_finished(const QString &url, QNetworkReply *reply) {
+    const QNetworkReply::NetworkError error = reply->error();
+    const int attempts = attempt_count[url];
+    const qint64 elapsed = elapsed_timers[url].elapsed();
+
+    const int retry_delay = [attempts]() {
+        const int delay = qMin(retry_delay_min_millis << (attempts - 1), retry_delay_max_millis);
+
+        // NOTE: jitter spreads out retries of clients
+        // that failed at the same time
+        static std::mt19937 generator(std::random_device{}());
+        std::uniform_int_distribution<int> distribution(delay / 2, delay * 3 / 2);
+
+        return distribution(generator);
+    }();
+
+    const bool retry = (error_is_temporary(error) && attempts < attempts_max && elapsed + retry_delay < deadline_millis);
+
+    const QJsonObject trace_args = {
+        {"attempt", attempts},
+        {"error", static_cast<int>(error)},
+    };
+    trace_async_span(url, "network", trace_start_times[url], trace_args);
+
+    if (retry) {
+        qDebug() << "Request for" << url << "failed:" << error << "Retrying in" << retry_delay << "ms";
+
+        retrying.insert(url);
+        QTimer::singleShot(retry_delay, this,
+            [this, url]() {
+                retrying.remove(url);
+                start_request(url);
+            });
+
+        return;
+    }
+
+    qDebug() << "Request for" << url << "finished in" << elapsed << "ms after" << attempts << "attempt(s), error:" << error;
+
+    emit reply_finished(url);
+
+    // Emit finished() signal when all requests are
+    // finished
     const bool all_finished = [&]() {
-        for (const QNetworkReply *reply : reply_list) {
-            const bool finished = reply->isFinished();
+        if (!retrying.isEmpty()) {
+            return false;
+        }
 
-            if (!finished) {
+        for (const QNetworkReply *other : reply_list) {
+            if (!other->isFinished()) {
                 return false;
             }
         }
@@ -85,8 +174,30 @@ QNetworkReply *makeNetworkRequest(const QString &url, const int time_out_millis)
     QNetworkRequest request(url);
     request.setAttribute(QNetworkRequest::FollowRedirectsAttribute, true);
 
+    return makeNetworkRequest(request, time_out_millis);
+}
+
+QNetworkReply *makeNetworkRequest(const QNetworkRequest &request, const int time_out_millis) {
     QNetworkReply *reply = network_access_manager->get(request);
 
+    // NOTE: a reply that is deleted while running never
+    // emits finished(), so the request is also counted
+    // as done when the reply is destroyed
+    active_request_count++;
+    const QSharedPointer<bool> counted = QSharedPointer<bool>::create(true);
+    const auto on_request_done = [counted]() {
+        if (*counted) {
+            *counted = false;
+            active_request_count--;
+        }
+    };
+    QObject::connect(
+        reply, &QNetworkReply::finished,
+        on_request_done);
+    QObject::connect(
+        reply, &QObject::destroyed,
+        on_request_done);
+
     // TODO: Qt 5.15 added QNetworkRequest::setTransferTimeout()
     // Abort download if it takes more than 5s
     if (time_out_millis > 0) {
@@ -101,3 +212,15 @@ QNetworkReply *makeNetworkRequest(const QString &url, const int time_out_millis)
 
     return reply;
 }
+
+int network_active_requests() {
+    return active_request_count;
+}
+
+// Network errors, proxy errors and server errors might go
+// away on retry, errors about content or protocol won't
+bool error_is_temporary(const QNetworkReply::NetworkError error) {
+    const bool content_error = (200 <= error && error < 400);
+
+    return (error != QNetworkReply::NoError && !content_error);
+}
@@ -24,13 +24,21 @@
 #define NETWORK_H
 
 #include <QObject>
+#include <QElapsedTimer>
 #include <QHash>
+#include <QSet>
 
 class QNetworkAccessManager;
 class QNetworkReply;
+class QNetworkRequest;
 
 extern QNetworkAccessManager *network_access_manager;
 
+// NOTE: requests that fail because of network or server
+// errors are retried with exponential backoff. Results
+// of other requests are kept while one is retried.
+// reply_finished() and finished() are only emitted
+// after the last attempt.
 class NetworkReplyGroup final : public QObject {
     Q_OBJECT
 
@@ -38,17 +46,29 @@ public:
     NetworkReplyGroup(const QList<QString> &url_list, QObject *parent);
     ~NetworkReplyGroup();
 
+    void add(const QString &url);
     QHash<QString, QNetworkReply *> get_reply_list() const;
 
 signals:
+    void reply_finished(const QString &url);
     void finished();
 
 private:
     QHash<QString, QNetworkReply *> reply_list;
+    QHash<QString, int> attempt_count;
+    QHash<QString, QElapsedTimer> elapsed_timers;
+    QHash<QString, qint64> trace_start_times;
+    QSet<QString> retrying;
 
-    void on_reply_finished();
+    void start_request(const QString &url);
+    void on_reply_finished(const QString &url, QNetworkReply *reply);
 };
 
 QNetworkReply *makeNetworkRequest(const QString &url, const int time_out_millis = 0);
+QNetworkReply *makeNetworkRequest(const QNetworkRequest &request, const int time_out_millis = 0);
+
+// Number of requests made by makeNetworkRequest() that
+// haven't finished yet
+int network_active_requests();
 
 #endif // NETWORK_H
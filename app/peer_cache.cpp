@@ -0,0 +1,363 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include "peer_cache.h"
+#include "file_type.h"
+#include "settings.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QNetworkInterface>
+#include <QRegExp>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+static QHostAddress lan_address();
+static bool address_is_lan(const QHostAddress &address);
+
+static int active_connection_count = 0;
+
+PeerCacheServer::PeerCacheServer(const QStringList &directories_arg, const quint16 port, QObject *parent)
+: QObject(parent) {
+    directories = directories_arg;
+    server = new QTcpServer(this);
+
+    connect(
+        server, &QTcpServer::newConnection,
+        this, &PeerCacheServer::onNewConnection);
+
+    // NOTE: images are only served in the LAN, never
+    // on all interfaces
+    const QHostAddress address = [&]() {
+        const QString address_setting = settings_peer_cache_address();
+
+        if (!address_setting.isEmpty()) {
+            return QHostAddress(address_setting);
+        } else {
+            return lan_address();
+        }
+    }();
+
+    if (address.isNull()) {
+        qDebug() << this->metaObject()->className() << "No LAN address to serve on";
+
+        return;
+    }
+
+    const bool listen_success = server->listen(address, port);
+    if (listen_success) {
+        qDebug() << this->metaObject()->className() << "Serving" << directories << "on" << address << "port" << server->serverPort();
+    } else {
+        qDebug() << this->metaObject()->className() << "Failed to listen on port" << port << server->errorString();
+    }
+}
+
+void PeerCacheServer::onNewConnection() {
+    while (server->hasPendingConnections()) {
+        QTcpSocket *socket = server->nextPendingConnection();
+
+        if (!address_is_lan(socket->peerAddress())) {
+            qDebug() << this->metaObject()->className() << "Refusing connection from" << socket->peerAddress();
+
+            socket->abort();
+            socket->deleteLater();
+
+            continue;
+        }
+
+        new PeerCacheConnection(socket, directories, this);
+    }
+}
+
+PeerCacheConnection::PeerCacheConnection(QTcpSocket *socket_arg, const QStringList &directories_arg, QObject *parent)
+: QObject(parent) {
+    socket = socket_arg;
+    socket->setParent(this);
+    directories = directories_arg;
+    file = nullptr;
+    remaining = 0;
+
+    active_connection_count++;
+
+    connect(
+        socket, &QTcpSocket::readyRead,
+        this, &PeerCacheConnection::onReadyRead);
+    connect(
+        socket, &QTcpSocket::bytesWritten,
+        this, &PeerCacheConnection::sendFileData);
+    connect(
+        socket, &QTcpSocket::disconnected,
+        this, &QObject::deleteLater);
+}
+
+PeerCacheConnection::~PeerCacheConnection() {
+    active_connection_count--;
+}
+
+void PeerCacheConnection::onReadyRead() {
+    // NOTE: only one request per connection is handled,
+    // ignore anything after it
+    if (file != nullptr) {
+        return;
+    }
+
+    request += socket->readAll();
+
+    // Don't accept unreasonably large headers
+    if (request.size() > 16 * 1024) {
+        sendError(400, "Bad Request");
+
+        return;
+    }
+
+    if (request.contains("\r\n\r\n")) {
+        handleRequest();
+    }
+}
+
+void PeerCacheConnection::handleRequest() {
+    const QList<QByteArray> lines = request.split('\n');
+    const QList<QByteArray> request_line = lines[0].trimmed().split(' ');
+
+    if (request_line.size() != 3) {
+        sendError(400, "Bad Request");
+
+        return;
+    }
+
+    const QByteArray method = request_line[0];
+    if (method != "GET" && method != "HEAD") {
+        sendError(405, "Method Not Allowed");
+
+        return;
+    }
+
+    // Only serve complete images that are directly in
+    // one of the directories
+    const QString file_name = QUrl::fromPercentEncoding(request_line[1]).mid(1);
+    const bool file_name_valid = (!file_name.isEmpty() && !file_name.contains('/') && !file_name.contains('\\') && !file_name.startsWith('.') && file_type_from_filename(file_name) != FileType_UNKNOWN);
+    if (!file_name_valid) {
+        sendError(404, "Not Found");
+
+        return;
+    }
+
+    const QString file_path = [this, file_name]() {
+        for (const QString &directory : directories) {
+            const QString out = QDir(directory).filePath(file_name);
+
+            if (QFile::exists(out)) {
+                return out;
+            }
+        }
+
+        return QString();
+    }();
+
+    file = new QFile(file_path, this);
+    const bool open_success = file->open(QIODevice::ReadOnly);
+    if (!open_success) {
+        sendError(404, "Not Found");
+
+        return;
+    }
+
+    const qint64 file_size = file->size();
+
+    // NOTE: only "bytes=start-" and "bytes=start-end"
+    // ranges are supported, which is what downloads use
+    qint64 range_start = 0;
+    qint64 range_end = file_size - 1;
+    bool is_range = false;
+
+    for (const QByteArray &line : lines) {
+        const QByteArray header = line.trimmed();
+
+        if (!header.toLower().startsWith("range:")) {
+            continue;
+        }
+
+        QRegExp range_regexp("bytes=(\\d+)-(\\d*)");
+        if (range_regexp.indexIn(QString(header)) == -1) {
+            continue;
+        }
+
+        range_start = range_regexp.cap(1).toLongLong();
+        if (!range_regexp.cap(2).isEmpty()) {
+            range_end = qMin(range_regexp.cap(2).toLongLong(), file_size - 1);
+        }
+        is_range = true;
+    }
+
+    const bool range_invalid = (range_start >= file_size || range_end < range_start);
+    if (is_range && range_invalid) {
+        sendError(416, "Range Not Satisfiable");
+
+        return;
+    }
+
+    remaining = range_end - range_start + 1;
+    file->seek(range_start);
+
+    QByteArray response;
+    if (is_range) {
+        response += "HTTP/1.1 206 Partial Content\r\n";
+        response += QString("Content-Range: bytes %1-%2/%3\r\n").arg(range_start).arg(range_end).arg(file_size).toLatin1();
+    } else {
+        response += "HTTP/1.1 200 OK\r\n";
+    }
+    response += "Accept-Ranges: bytes\r\n";
+    response += "Content-Type: application/octet-stream\r\n";
+    response += QString("Content-Length: %1\r\n").arg(remaining).toLatin1();
+    response += "Connection: close\r\n";
+    response += "\r\n";
+
+    socket->write(response);
+
+    if (method == "HEAD") {
+        remaining = 0;
+    }
+
+    qDebug() << this->metaObject()->className() << "Serving" << file_name << "from" << range_start << "to peer" << socket->peerAddress().toString();
+
+    sendFileData();
+}
+
+// Send file in chunks, more data is sent as socket's
+// buffer empties so that the whole image isn't loaded into
+// memory
+void PeerCacheConnection::sendFileData() {
+    static const qint64 chunk_size = 1024L * 1024L;
+
+    if (file == nullptr) {
+        return;
+    }
+
+    while (remaining > 0 && socket->bytesToWrite() < 4 * chunk_size) {
+        const QByteArray data = file->read(qMin(chunk_size, remaining));
+
+        if (data.isEmpty()) {
+            qDebug() << this->metaObject()->className() << "Failed to read" << file->fileName();
+            socket->abort();
+
+            return;
+        }
+
+        socket->write(data);
+        remaining -= data.size();
+    }
+
+    // NOTE: disconnecting waits for the remaining data
+    // to be written
+    if (remaining == 0) {
+        close();
+    }
+}
+
+void PeerCacheConnection::sendError(const int code, const QByteArray &reason) {
+    QByteArray response;
+    response += QString("HTTP/1.1 %1 ").arg(code).toLatin1() + reason + "\r\n";
+    response += "Content-Length: 0\r\n";
+    response += "Connection: close\r\n";
+    response += "\r\n";
+
+    socket->write(response);
+    close();
+}
+
+void PeerCacheConnection::close() {
+    disconnect(socket, &QTcpSocket::bytesWritten, this, &PeerCacheConnection::sendFileData);
+    socket->disconnectFromHost();
+}
+
+QList<QUrl> peer_cache_urls(const QString &file_name) {
+    QList<QUrl> out;
+
+    const QStringList peers = settings_peer_cache_peers();
+    for (const QString &peer : peers) {
+        const QUrl url(QString("http://%1/%2").arg(peer, QString(QUrl::toPercentEncoding(file_name))));
+
+        if (url.isValid()) {
+            out.append(url);
+        }
+    }
+
+    return out;
+}
+
+int peer_cache_active_connections() {
+    return active_connection_count;
+}
+
+// Returns the first private address of this machine, or
+// a null address if it's not in a LAN
+QHostAddress lan_address() {
+    const QList<QHostAddress> address_list = QNetworkInterface::allAddresses();
+
+    for (const QHostAddress &address : address_list) {
+        const bool is_ipv4 = (address.protocol() == QAbstractSocket::IPv4Protocol);
+
+        if (is_ipv4 && !address.isLoopback() && address_is_lan(address)) {
+            return address;
+        }
+    }
+
+    return QHostAddress();
+}
+
+// Private and link-local ranges, loopback is allowed for
+// trying out peers on one machine
+bool address_is_lan(const QHostAddress &address_arg) {
+    static const QList<QString> subnet_list = {
+        "10.0.0.0/8",
+        "172.16.0.0/12",
+        "192.168.0.0/16",
+        "169.254.0.0/16",
+        "127.0.0.0/8",
+        "fc00::/7",
+        "fe80::/10",
+        "::1/128",
+    };
+
+    // NOTE: IPv4 clients of a dual stack socket come as
+    // IPv4-mapped IPv6 addresses
+    const QHostAddress address = [&]() {
+        bool is_ipv4 = false;
+        const quint32 ipv4 = address_arg.toIPv4Address(&is_ipv4);
+
+        if (is_ipv4) {
+            return QHostAddress(ipv4);
+        } else {
+            return address_arg;
+        }
+    }();
+
+    for (const QString &subnet : subnet_list) {
+        if (address.isInSubnet(QHostAddress::parseSubnet(subnet))) {
+            return true;
+        }
+    }
+
+    return false;
+}
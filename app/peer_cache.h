@@ -0,0 +1,88 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef PEER_CACHE_H
+#define PEER_CACHE_H
+
+/*
+ * Peer cache lets workstations in a LAN share downloaded
+ * images with each other. An instance with serving
+ * enabled runs an HTTP server that serves images from its
+ * download directories, with support for range requests.
+ * Other instances are configured with a list of peer
+ * addresses and try them before downloading from the
+ * internet. Images from peers are checked against md5
+ * sums like any other download.
+ */
+
+#include <QList>
+#include <QObject>
+#include <QStringList>
+#include <QUrl>
+
+class QFile;
+class QTcpServer;
+class QTcpSocket;
+
+class PeerCacheServer final : public QObject {
+    Q_OBJECT
+
+public:
+    PeerCacheServer(const QStringList &directories_arg, const quint16 port, QObject *parent);
+
+private:
+    QStringList directories;
+    QTcpServer *server;
+
+    void onNewConnection();
+};
+
+class PeerCacheConnection final : public QObject {
+    Q_OBJECT
+
+public:
+    PeerCacheConnection(QTcpSocket *socket_arg, const QStringList &directories_arg, QObject *parent);
+    ~PeerCacheConnection();
+
+private:
+    QTcpSocket *socket;
+    QStringList directories;
+    QByteArray request;
+    QFile *file;
+    qint64 remaining;
+
+    void onReadyRead();
+    void handleRequest();
+    void sendError(const int code, const QByteArray &reason);
+    void sendFileData();
+    void close();
+};
+
+// Returns urls of the image with this file name on
+// configured peers
+QList<QUrl> peer_cache_urls(const QString &file_name);
+
+// Number of peers currently connected to this instance
+int peer_cache_active_connections();
+
+#endif // PEER_CACHE_H
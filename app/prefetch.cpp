@@ -0,0 +1,211 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include "prefetch.h"
+#include "image_download.h"
+#include "image_files.h"
+#include "network.h"
+#include "peer_cache.h"
+#include "throughput.h"
+#include "variant.h"
+
+#include <QDebug>
+#include <QFileInfo>
+#include <QStorageInfo>
+#include <QTimer>
+
+// Wait for the network to be idle for this long before
+// prefetching
+const int PREFETCH_IDLE_MILLIS = 60 * 1000;
+
+// Leave plenty of space for user's own files
+const qint64 PREFETCH_MIN_FREE_SPACE = 16LL * 1024LL * 1024LL * 1024LL;
+
+// Prefetch uses this part of the measured download
+// speed, so that it doesn't get in the way of the user
+const int PREFETCH_SPEED_DIVISOR = 4;
+// Used when download speed wasn't measured yet
+const qint64 PREFETCH_RATE_DEFAULT = 1024LL * 1024LL;
+
+Prefetcher *Prefetcher::_self = nullptr;
+
+Prefetcher *Prefetcher::instance() {
+    if (!_self) {
+        _self = new Prefetcher();
+    }
+    return _self;
+}
+
+Prefetcher::Prefetcher(QObject *parent)
+: QObject(parent) {
+    userDownloadCount = 0;
+
+    idleTimer = new QTimer(this);
+    idleTimer->setSingleShot(true);
+    idleTimer->setInterval(PREFETCH_IDLE_MILLIS);
+
+    connect(
+        idleTimer, &QTimer::timeout,
+        this, &Prefetcher::startNext);
+}
+
+void Prefetcher::setCandidates(const QList<Variant *> &list) {
+    candidates.clear();
+    for (Variant *variant : list) {
+        candidates.append(variant);
+    }
+
+    qDebug() << this->metaObject()->className() << "Got" << candidates.size() << "candidates";
+
+    if (download == nullptr && userDownloadCount == 0) {
+        idleTimer->start();
+    }
+}
+
+void Prefetcher::userDownloadStarted() {
+    userDownloadCount++;
+    idleTimer->stop();
+
+    // NOTE: cancelled download keeps the partial file,
+    // so it can be continued later either by prefetch
+    // or by the user's download
+    if (download != nullptr) {
+        qDebug() << this->metaObject()->className() << "Pausing for user download";
+
+        download->cancel();
+        download = nullptr;
+    }
+}
+
+void Prefetcher::userDownloadFinished() {
+    userDownloadCount = qMax(0, userDownloadCount - 1);
+
+    if (userDownloadCount == 0) {
+        idleTimer->start();
+    }
+}
+
+void Prefetcher::startNext() {
+    if (download != nullptr || userDownloadCount > 0) {
+        return;
+    }
+
+    // NOTE: "idle" only means that this app isn't using
+    // the network, other apps aren't checked. Prefetch
+    // is throttled to make up for that.
+    const bool network_busy = (network_active_requests() > 0 || peer_cache_active_connections() > 0);
+    if (network_busy) {
+        idleTimer->start();
+
+        return;
+    }
+
+    while (!candidates.isEmpty()) {
+        Variant *variant = candidates.first();
+
+        const bool skip = (variant == nullptr || variant->url().isEmpty() || ImageFiles::instance()->exists(variant->filePath()));
+        if (skip) {
+            candidates.removeFirst();
+
+            continue;
+        }
+
+        const QStorageInfo storage(QFileInfo(variant->filePath()).absolutePath());
+        if (storage.bytesAvailable() < PREFETCH_MIN_FREE_SPACE) {
+            qDebug() << this->metaObject()->className() << "Not enough free space to prefetch";
+
+            return;
+        }
+
+        // NOTE: md5sum is needed to check the download,
+        // continue once it's fetched
+        if (!variant->md5sumFetched()) {
+            connect(
+                variant, &Variant::md5sumChanged,
+                this, &Prefetcher::startNext, Qt::UniqueConnection);
+            connect(
+                variant, &Variant::md5sumFailed,
+                this, &Prefetcher::onMd5sumFailed, Qt::UniqueConnection);
+            variant->fetchMd5sum();
+
+            return;
+        }
+
+        qDebug() << this->metaObject()->className() << "Prefetching" << variant->fileName();
+
+        download = new ImageDownload(QUrl(variant->url()), variant->filePath(), variant->md5sum(), peer_cache_urls(variant->fileName()));
+        downloadVariant = variant;
+
+        const qint64 rate_limit = [&]() {
+            const qint64 speed = throughput_download();
+
+            if (speed > 0) {
+                return qMax(speed / PREFETCH_SPEED_DIVISOR, 64LL * 1024LL);
+            } else {
+                return PREFETCH_RATE_DEFAULT;
+            }
+        }();
+        download->setRateLimit(rate_limit);
+
+        connect(
+            download, &ImageDownload::finished,
+            this, &Prefetcher::onDownloadFinished);
+
+        return;
+    }
+}
+
+// Image can't be checked without md5sum, so it's skipped
+// this time
+void Prefetcher::onMd5sumFailed() {
+    Variant *variant = qobject_cast<Variant *>(sender());
+
+    qDebug() << this->metaObject()->className() << "Skipping" << variant->fileName() << "because md5sum couldn't be fetched";
+
+    candidates.removeAll(variant);
+
+    if (download == nullptr && userDownloadCount == 0) {
+        idleTimer->start();
+    }
+}
+
+void Prefetcher::onDownloadFinished() {
+    ImageDownload *finished_download = qobject_cast<ImageDownload *>(sender());
+
+    // Paused downloads are continued later
+    if (finished_download->result() == ImageDownload::Cancelled) {
+        return;
+    }
+
+    qDebug() << this->metaObject()->className() << "Prefetch finished with result" << finished_download->result();
+
+    // NOTE: failed downloads are not retried, so that a
+    // broken image isn't downloaded over and over.
+    // Candidates might have been replaced since the
+    // download started, so it's not necessarily first.
+    candidates.removeAll(downloadVariant);
+    download = nullptr;
+    downloadVariant = nullptr;
+
+    QTimer::singleShot(0, this, &Prefetcher::startNext);
+}
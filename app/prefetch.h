@@ -0,0 +1,79 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+/*
+ * Prefetcher downloads images that the user is likely to
+ * pick, in the background, so that they are ready by the
+ * time user gets to them. Prefetching only happens while
+ * there are no downloads started by the user. When user
+ * starts a download, prefetch is paused immediately and
+ * continues from the same place later. Prefetched images
+ * go to the usual download location and are checked
+ * like any other download. Prefetch waits until the
+ * app's network requests are idle for a while and is
+ * limited to a part of the measured download speed.
+ */
+
+#include <QList>
+#include <QObject>
+#include <QPointer>
+
+class ImageDownload;
+class QTimer;
+class Variant;
+
+class Prefetcher final : public QObject {
+    Q_OBJECT
+
+public:
+    static Prefetcher *instance();
+
+    // Variants to prefetch, in order of priority
+    void setCandidates(const QList<Variant *> &list);
+
+    // NOTE: must be called before user's download is
+    // created because it might be writing to the same
+    // file as prefetch
+    void userDownloadStarted();
+    void userDownloadFinished();
+
+private:
+    explicit Prefetcher(QObject *parent = nullptr);
+
+    static Prefetcher *_self;
+    QList<QPointer<Variant>> candidates;
+    QPointer<ImageDownload> download;
+    // Variant that is being prefetched
+    QPointer<Variant> downloadVariant;
+    int userDownloadCount;
+    QTimer *idleTimer;
+
+    void startNext();
+    void onMd5sumFailed();
+    void onDownloadFinished();
+};
+
+#endif // PREFETCH_H
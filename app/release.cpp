@@ -22,7 +22,10 @@
 
 #include "release.h"
 #include "architecture.h"
+#include "drivemanager.h"
+#include "icon_provider.h"
 #include "releasemanager.h"
+#include "throughput.h"
 #include "variant.h"
 
 #include <QDebug>
@@ -37,10 +40,11 @@ Release::Release(const QString &name, const QString &display_name, const QString
     m_screenshots = screenshots;
     m_isCustom = false;
     m_selectedVariant = 0;
+    m_variantPicked = false;
 }
 
 Release *Release::custom(QObject *parent) {
-    auto customRelease = new Release(QString(), tr("Custom image"), QT_TRANSLATE_NOOP("Release", "Pick a file from your drive(s)"), {QT_TRANSLATE_NOOP("Release", "<p>Here you can choose a OS image from your hard drive to be written to your flash disk</p><p>Currently it is only supported to write raw disk images (.iso or .bin)</p>")}, "qrc:/logo/custom", {}, parent);
+    auto customRelease = new Release(QString(), tr("Custom image"), QT_TRANSLATE_NOOP("Release", "Pick a file from your drive(s)"), {QT_TRANSLATE_NOOP("Release", "<p>Here you can choose a OS image from your hard drive to be written to your flash disk</p><p>Currently it is only supported to write raw disk images (.iso or .bin)</p>")}, IconProvider::url("custom"), {}, parent);
     customRelease->m_isCustom = true;
     customRelease->setLocalFile(QString());
 
@@ -64,6 +68,16 @@ void Release::addVariant(Variant *variant) {
     m_variants.insert(insert_index, variant);
     emit variantsChanged();
 
+    connect(
+        variant, &Variant::sizeChanged,
+        this, &Release::updateEstimates);
+
+    // NOTE: arch and board are used for filtering and
+    // search
+    connect(
+        variant, &Variant::detailsChanged,
+        this, &Release::variantsChanged);
+
     // Select first variant by default
     if (m_variants.count() == 1) {
         m_selectedVariant = 0;
@@ -71,6 +85,43 @@ void Release::addVariant(Variant *variant) {
     }
 }
 
+// NOTE: variant is not deleted, caller does that once
+// QML is done with it
+void Release::removeVariant(Variant *variant) {
+    const int index = m_variants.indexOf(variant);
+    if (index == -1) {
+        return;
+    }
+
+    m_variants.removeAt(index);
+    disconnect(variant, nullptr, this, nullptr);
+    emit variantsChanged();
+
+    // Keep the same variant selected, if it's still
+    // there
+    if (index < m_selectedVariant) {
+        m_selectedVariant--;
+        emit selectedVariantChanged();
+    } else if (index == m_selectedVariant) {
+        m_selectedVariant = 0;
+        emit selectedVariantChanged();
+    }
+
+    updateEstimates();
+}
+
+void Release::setDetails(const QString &displayName, const QString &summary, const QString &description, const QString &icon) {
+    const bool changed = (m_displayName != displayName || m_summary != summary || m_description != description || m_icon != icon);
+
+    if (changed) {
+        m_displayName = displayName;
+        m_summary = summary;
+        m_description = description;
+        m_icon = icon;
+        emit detailsChanged();
+    }
+}
+
 void Release::setLocalFile(const QUrl &fileUrl) {
     QString filePath = fileUrl.path();
 
@@ -140,7 +191,13 @@ int Release::selectedVariantIndex() const {
 void Release::setSelectedVariantIndex(const int index) {
     if (m_selectedVariant != index && m_selectedVariant >= 0 && m_selectedVariant < m_variants.count()) {
         m_selectedVariant = index;
+        m_variantPicked = true;
         emit selectedVariantChanged();
+
+        Variant *variant = selectedVariant();
+        if (variant != nullptr) {
+            variant->fetchMd5sum();
+        }
     }
 }
 
@@ -151,3 +208,93 @@ QQmlListProperty<Variant> Release::variants() {
 QList<Variant *> Release::variantList() const {
     return m_variants;
 }
+
+// Estimates how long it would take to get each variant
+// onto the selected drive. When the same image is
+// available in several formats, the fastest one is
+// recommended and is selected if the user didn't pick a
+// variant yet.
+void Release::updateEstimates() {
+    const Drive *drive = DriveManager::instance()->selected();
+    const QString drive_name = [drive]() {
+        if (drive != nullptr) {
+            return drive->name();
+        } else {
+            return QString();
+        }
+    }();
+
+    const QHash<Variant *, int> estimates = [&]() {
+        QHash<Variant *, int> out;
+
+        for (Variant *variant : m_variants) {
+            // NOTE: decompressed size of a compressed
+            // image is only known if the same image is
+            // also available uncompressed
+            const qint64 image_size = [&]() -> qint64 {
+                if (!variant->isCompressed()) {
+                    return variant->size();
+                }
+
+                for (const Variant *other : m_variants) {
+                    if (other->isEquivalent(variant) && !other->isCompressed() && other->size() > 0) {
+                        return other->size();
+                    }
+                }
+
+                return 0;
+            }();
+
+            out[variant] = throughput_total_estimate(variant->size(), image_size, variant->isCompressed(), drive_name);
+        }
+
+        return out;
+    }();
+
+    // Fastest variant out of each group of equivalent
+    // variants, if all of them could be estimated
+    const auto fastest_equivalent = [&](Variant *variant) -> Variant * {
+        Variant *out = nullptr;
+        int equivalent_count = 0;
+
+        for (Variant *other : m_variants) {
+            if (!other->isEquivalent(variant)) {
+                continue;
+            }
+
+            if (estimates[other] < 0) {
+                return nullptr;
+            }
+
+            equivalent_count++;
+
+            if (out == nullptr || estimates[other] < estimates[out]) {
+                out = other;
+            }
+        }
+
+        if (equivalent_count > 1) {
+            return out;
+        } else {
+            return nullptr;
+        }
+    };
+
+    for (Variant *variant : m_variants) {
+        const bool recommended = (fastest_equivalent(variant) == variant);
+
+        variant->setEstimate(estimates[variant], recommended);
+    }
+
+    Variant *selected = selectedVariant();
+    if (!m_variantPicked && selected != nullptr) {
+        Variant *fastest = fastest_equivalent(selected);
+
+        if (fastest != nullptr && fastest != selected) {
+            qDebug() << "Selecting" << fastest->fileName() << "instead of" << selected->fileName() << "because it's faster to download and write";
+
+            m_selectedVariant = m_variants.indexOf(fastest);
+            emit selectedVariantChanged();
+        }
+    }
+}
@@ -54,13 +54,13 @@ class Variant;
 
 class Release : public QObject {
     Q_OBJECT
-    Q_PROPERTY(QString displayName READ displayName CONSTANT)
-    Q_PROPERTY(QString summary READ summary CONSTANT)
-    Q_PROPERTY(QString description READ description CONSTANT)
+    Q_PROPERTY(QString displayName READ displayName NOTIFY detailsChanged)
+    Q_PROPERTY(QString summary READ summary NOTIFY detailsChanged)
+    Q_PROPERTY(QString description READ description NOTIFY detailsChanged)
 
     Q_PROPERTY(bool isCustom READ isCustom CONSTANT)
 
-    Q_PROPERTY(QString icon READ icon CONSTANT)
+    Q_PROPERTY(QString icon READ icon NOTIFY detailsChanged)
     Q_PROPERTY(QStringList screenshots READ screenshots CONSTANT)
 
     Q_PROPERTY(QQmlListProperty<Variant> variants READ variants NOTIFY variantsChanged)
@@ -72,6 +72,9 @@ public:
     static Release *custom(QObject *parent);
 
     void addVariant(Variant *variant);
+    void removeVariant(Variant *variant);
+    // Updates details when metadata changes
+    void setDetails(const QString &displayName, const QString &summary, const QString &description, const QString &icon);
 
     Q_INVOKABLE void setLocalFile(const QUrl &fileUrl);
 
@@ -89,7 +92,13 @@ public:
     int selectedVariantIndex() const;
     void setSelectedVariantIndex(const int index);
 
+    // NOTE: only the selected release shows estimates,
+    // so ReleaseManager calls this for it when the drive
+    // or the selected release changes
+    void updateEstimates();
+
 signals:
+    void detailsChanged();
     void variantsChanged();
     void selectedVariantChanged();
 
@@ -102,6 +111,7 @@ private:
     QStringList m_screenshots;
     QList<Variant *> m_variants;
     int m_selectedVariant;
+    bool m_variantPicked;
     bool m_isCustom;
 };
 
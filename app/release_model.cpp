@@ -22,25 +22,39 @@
 
 #include "release_model.h"
 #include "release.h"
+#include "trace.h"
 #include "variant.h"
 
-Release *ReleaseModel::get(const int index) const {
-    QStandardItem *the_item = item(index);
+#include <QTimer>
+
+#include <algorithm>
+#include <functional>
+
+ReleaseModel::ReleaseModel(QObject *parent)
+: QAbstractListModel(parent) {
+    rowsValidUntil = 0;
+}
 
-    if (the_item != nullptr) {
-        QVariant variant = the_item->data();
-        Release *release = variant.value<Release *>();
+int ReleaseModel::rowCount(const QModelIndex &parent) const {
+    if (parent.isValid()) {
+        return 0;
+    }
+
+    return releases.size();
+}
 
-        return release;
+QVariant ReleaseModel::data(const QModelIndex &index, int role) const {
+    Release *release = get(index.row());
+
+    if (release != nullptr && role == Qt::UserRole + 1) {
+        return QVariant::fromValue(release);
     } else {
-        return nullptr;
+        return QVariant();
     }
 }
 
-// NOTE: this is a very roundabout way of making the Release
-// pointer stored inside the item available in the qml
-// delegate as "release". (Qt::UserRole + 1 is the default
-// data role)
+// NOTE: this makes the Release pointer available in
+// the qml delegate as "release"
 QHash<int, QByteArray> ReleaseModel::roleNames() const {
     static const QHash<int, QByteArray> names = {
         {Qt::UserRole + 1, "release"},
@@ -49,6 +63,174 @@ QHash<int, QByteArray> ReleaseModel::roleNames() const {
     return names;
 }
 
+Release *ReleaseModel::get(const int index) const {
+    if (0 <= index && index < releases.size()) {
+        return releases[index];
+    } else {
+        return nullptr;
+    }
+}
+
+// Returns nullptr if there's no release with this name.
+// If names repeat, the release in the first row is
+// returned, same as when scanning rows.
+Release *ReleaseModel::find(const QString &name) const {
+    const QList<Release *> matches = releaseByName.values(name);
+
+    Release *out = nullptr;
+    int out_row = -1;
+
+    for (Release *release : matches) {
+        const int row = indexOf(release);
+
+        if (out == nullptr || row < out_row) {
+            out = release;
+            out_row = row;
+        }
+    }
+
+    return out;
+}
+
+// Returns matching releases and their ranks
+QHash<const Release *, qreal> ReleaseModel::search(const QString &text) const {
+    return searchIndex.search(text);
+}
+
+// Returns -1 if release is not in the model
+int ReleaseModel::indexOf(const Release *release) const {
+    if (!rowByRelease.contains(release)) {
+        return -1;
+    }
+
+    if (rowByRelease[release] >= rowsValidUntil) {
+        updateRows();
+    }
+
+    return rowByRelease[release];
+}
+
+bool ReleaseModel::hasArch(const int index, const Architecture arch) const {
+    const Release *release = get(index);
+    const quint32 mask = archMasks.value(release, 0);
+
+    return ((mask & (1u << arch)) != 0);
+}
+
+void ReleaseModel::insertReleases(const int index_arg, const QList<Release *> &list) {
+    if (list.isEmpty()) {
+        return;
+    }
+
+    const int index = qBound(0, index_arg, releases.size());
+
+    beginInsertRows(QModelIndex(), index, index + list.size() - 1);
+
+    for (int i = 0; i < list.size(); i++) {
+        Release *release = list[i];
+
+        releases.insert(index + i, release);
+        releaseByName.insert(release->name(), release);
+        rowByRelease[release] = index + i;
+        searchIndex.add(release);
+        updateArchMask(release);
+
+        connect(
+            release, &Release::variantsChanged,
+            this, [this, release]() {
+                updateArchMask(release);
+                searchIndex.updateVariants(release);
+
+                emit searchIndexChanged();
+            });
+        connect(
+            release, &Release::detailsChanged,
+            this, [this, release]() {
+                searchIndex.remove(release);
+                searchIndex.add(release);
+
+                const QModelIndex model_index = index(indexOf(release));
+                emit dataChanged(model_index, model_index);
+                emit searchIndexChanged();
+            });
+    }
+
+    // Rows after the inserted ones have moved
+    rowsValidUntil = qMin(rowsValidUntil, index);
+
+    endInsertRows();
+
+    emit searchIndexChanged();
+}
+
+// NOTE: releases are not deleted, ReleaseManager does
+// that once QML is done with them
+void ReleaseModel::removeReleases(const QList<Release *> &list) {
+    QList<int> rows;
+    for (const Release *release : list) {
+        const int row = indexOf(release);
+
+        if (row != -1) {
+            rows.append(row);
+        }
+    }
+
+    if (rows.isEmpty()) {
+        return;
+    }
+
+    // NOTE: rows are removed from the end, so that
+    // rows that are still to be removed don't move
+    std::sort(rows.begin(), rows.end(), std::greater<int>());
+
+    int i = 0;
+    while (i < rows.size()) {
+        const int last = rows[i];
+        int first = last;
+        i++;
+
+        while (i < rows.size() && rows[i] == first - 1) {
+            first--;
+            i++;
+        }
+
+        beginRemoveRows(QModelIndex(), first, last);
+
+        for (int row = last; row >= first; row--) {
+            Release *release = releases.takeAt(row);
+            releaseByName.remove(release->name(), release);
+            rowByRelease.remove(release);
+            archMasks.remove(release);
+            searchIndex.remove(release);
+            disconnect(release, nullptr, this, nullptr);
+        }
+
+        rowsValidUntil = qMin(rowsValidUntil, first);
+
+        endRemoveRows();
+    }
+
+    emit searchIndexChanged();
+}
+
+void ReleaseModel::updateArchMask(const Release *release) {
+    quint32 mask = 0;
+
+    for (const Variant *variant : release->variantList()) {
+        mask |= (1u << variant->arch());
+    }
+
+    archMasks[release] = mask;
+}
+
+void ReleaseModel::updateRows() const {
+    for (int row = rowsValidUntil; row < releases.size(); row++) {
+        rowByRelease[releases[row]] = row;
+    }
+
+    rowsValidUntil = releases.size();
+}
+
 ReleaseFilterModel::ReleaseFilterModel(ReleaseModel *model_arg, QObject *parent)
 : QSortFilterProxyModel(parent) {
     model = model_arg;
@@ -56,6 +238,23 @@ ReleaseFilterModel::ReleaseFilterModel(ReleaseModel *model_arg, QObject *parent)
     filterArch = Architecture_ALL;
 
     setSourceModel(model_arg);
+
+    filterTextTimer = new QTimer(this);
+    filterTextTimer->setSingleShot(true);
+    filterTextTimer->setInterval(150);
+    connect(
+        filterTextTimer, &QTimer::timeout,
+        this, &ReleaseFilterModel::applyFilterText);
+
+    // Search again when catalog changes, timer makes
+    // sure that it happens once per batch of changes
+    connect(
+        model, &ReleaseModel::searchIndexChanged,
+        this, [this]() {
+            if (!filterText.isEmpty()) {
+                filterTextTimer->start();
+            }
+        });
 }
 
 bool ReleaseFilterModel::filterAcceptsRow(int source_row, const QModelIndex &) const {
@@ -66,37 +265,21 @@ bool ReleaseFilterModel::filterAcceptsRow(int source_row, const QModelIndex &) c
     }
 
     if (frontPage) {
-        // Don't filter when on front page, just show 3 releases
-        const bool on_front_page = (source_row < 3);
-
-        return on_front_page;
+        // Don't filter when on front page
+        return isOnFrontPage(source_row);
     } else if (release->isCustom()) {
         // Always show local release
         return true;
     } else {
-        const bool releaseMatchesName = release->displayName().contains(filterText, Qt::CaseInsensitive);
+        const bool releaseMatchesText = (filterText.isEmpty() || textMatches.contains(release));
 
-        // Exit early if don't match name to skip checking
-        // for arch because that takes a long time
-        // TODO: cache that somehow?
-        if (!releaseMatchesName) {
+        if (!releaseMatchesText) {
             return false;
         }
 
-        // Otherwise filter by arch
-        const bool releaseHasVariantWithArch = [this, release]() {
-            // If filtering for all, accept all architectures
-            if (filterArch == Architecture_ALL) {
-                return true;
-            }
-
-            for (const Variant *variant : release->variantList()) {
-                if (variant->arch() == filterArch) {
-                    return true;
-                }
-            }
-            return false;
-        }();
+        // Otherwise filter by arch. If filtering for
+        // all, accept all architectures.
+        const bool releaseHasVariantWithArch = (filterArch == Architecture_ALL || model->hasArch(source_row, filterArch));
 
         if (!releaseHasVariantWithArch) {
             return false;
@@ -106,6 +289,33 @@ bool ReleaseFilterModel::filterAcceptsRow(int source_row, const QModelIndex &) c
     }
 }
 
+// Better matches go first, custom release is always
+// first
+bool ReleaseFilterModel::lessThan(const QModelIndex &source_left, const QModelIndex &source_right) const {
+    const int left_row = source_left.row();
+    const int right_row = source_right.row();
+    const Release *left = model->get(left_row);
+    const Release *right = model->get(right_row);
+
+    if (left->isCustom() != right->isCustom()) {
+        return left->isCustom();
+    }
+
+    const qreal left_rank = textMatches.value(left);
+    const qreal right_rank = textMatches.value(right);
+
+    if (left_rank != right_rank) {
+        return (left_rank > right_rank);
+    } else {
+        return (left_row < right_row);
+    }
+}
+
+// Just show 3 releases on front page
+bool ReleaseFilterModel::isOnFrontPage(const int source_row) {
+    return (source_row < 3);
+}
+
 bool ReleaseFilterModel::getFrontPage() const {
     return frontPage;
 }
@@ -119,14 +329,36 @@ void ReleaseFilterModel::leaveFrontPage() {
 }
 
 void ReleaseFilterModel::setFilterText(const QString &text) {
-    filterText = text;
+    pendingFilterText = text.trimmed();
+    filterTextTimer->start();
+}
+
+void ReleaseFilterModel::applyFilterText() {
+    const qint64 trace_start_time = trace_now();
+
+    filterText = pendingFilterText;
+    textMatches = model->search(filterText);
 
     invalidateFilter();
+
+    // NOTE: without text, releases are in the same
+    // order as in the source model
+    if (filterText.isEmpty()) {
+        sort(-1);
+    } else {
+        sort(0);
+    }
+
+    trace_span("Filter by text", "model", trace_start_time, {{"matches", textMatches.size()}});
 }
 
 void ReleaseFilterModel::setFilterArch(const int index) {
+    const qint64 trace_start_time = trace_now();
+
     filterArch = (Architecture) index;
     invalidateFilter();
+
+    trace_span("Filter by architecture", "model", trace_start_time);
 }
 
 void ReleaseFilterModel::invalidateCustom() {
@@ -25,6 +25,11 @@
 
 /*
  * ReleaseModel stores releases and ReleaseFilterModel filters them.
+ * ReleaseModel keeps an index of releases by name, the row of each
+ * release and a mask of architectures of each release's variants,
+ * so that lookups don't have to scan rows. Releases are inserted
+ * and removed in batches, with one model change per batch of
+ * adjacent rows. Rows are renumbered lazily, once per batch.
  * While the filter is on the "front page", a small number of releases
  * is shown without filtering. Outside the front page all releases are
  * shown and filtering is enabled. Releases can be filtered by name
@@ -33,20 +38,47 @@
  */
 
 #include "architecture.h"
+#include "search_index.h"
 
+#include <QAbstractListModel>
 #include <QSortFilterProxyModel>
-#include <QStandardItemModel>
 
 class Release;
+class QTimer;
 
-class ReleaseModel final : public QStandardItemModel {
+class ReleaseModel final : public QAbstractListModel {
     Q_OBJECT
 
 public:
-    using QStandardItemModel::QStandardItemModel;
+    explicit ReleaseModel(QObject *parent = nullptr);
 
-    Release *get(const int index) const;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role) const override;
     QHash<int, QByteArray> roleNames() const override;
+
+    Release *get(const int index) const;
+    Release *find(const QString &name) const;
+    int indexOf(const Release *release) const;
+    QHash<const Release *, qreal> search(const QString &text) const;
+    bool hasArch(const int index, const Architecture arch) const;
+
+    void insertReleases(const int index, const QList<Release *> &list);
+    void removeReleases(const QList<Release *> &list);
+
+signals:
+    void searchIndexChanged();
+
+private:
+    QList<Release *> releases;
+    QMultiHash<QString, Release *> releaseByName;
+    // Rows before rowsValidUntil are up to date
+    mutable QHash<const Release *, int> rowByRelease;
+    mutable int rowsValidUntil;
+    QHash<const Release *, quint32> archMasks;
+    SearchIndex searchIndex;
+
+    void updateArchMask(const Release *release);
+    void updateRows() const;
 };
 
 class ReleaseFilterModel final : public QSortFilterProxyModel {
@@ -57,8 +89,11 @@ public:
     ReleaseFilterModel(ReleaseModel *model_arg, QObject *parent);
 
     bool filterAcceptsRow(int source_row, const QModelIndex &source_parent) const override;
+    bool lessThan(const QModelIndex &source_left, const QModelIndex &source_right) const override;
     void invalidateCustom();
 
+    static bool isOnFrontPage(const int source_row);
+
     bool getFrontPage() const;
     Q_INVOKABLE void leaveFrontPage();
     Q_INVOKABLE void setFilterArch(const int index);
@@ -72,6 +107,11 @@ private:
     bool frontPage;
     QString filterText;
     Architecture filterArch;
+    QTimer *filterTextTimer;
+    QString pendingFilterText;
+    QHash<const Release *, qreal> textMatches;
+
+    void applyFilterText();
 };
 
 #endif // RELEASE_MODEL_H
@@ -22,14 +22,20 @@
 
 #include "releasemanager.h"
 #include "architecture.h"
+#include "catalog.h"
+#include "drivemanager.h"
 #include "file_type.h"
+#include "md5sum_fetcher.h"
+#include "metadata_cache.h"
 #include "network.h"
+#include "prefetch.h"
 #include "release.h"
 #include "release_model.h"
+#include "settings.h"
+#include "throughput.h"
+#include "trace.h"
 #include "variant.h"
 
-#include <yaml-cpp/yaml.h>
-
 #include <QAbstractEventDispatcher>
 #include <QApplication>
 #include <QtQml>
@@ -38,441 +44,570 @@ const QString METADATA_URLS_HOST = "http://getalt.org";
 const QString METADATA_URLS_BACKUP_HOST = "http://kvel2d.github.io/posts";
 
 QList<QString> load_list_from_file(const QString &filepath);
-QString yml_get(const YAML::Node &node, const QString &key);
+QList<QString> metadata_hosts();
+bool release_is_busy(const Release *release);
 QList<QString> get_metadata_urls_list(const QString &host);
 
 ReleaseManager::ReleaseManager(QObject *parent)
 : QObject(parent) {
     m_downloadingMetadata = true;
-    metadata_urls_reply_group = nullptr;
-    metadata_urls_backup_reply_group = nullptr;
+    metadataTraceStartTime = 0;
     metadata_reply_group = nullptr;
-    md5sum_reply_group = nullptr;
+    catalogLoaded = false;
+    loadedSectionsCount = 0;
+    mirrorPaths = settings_mirror_paths();
 
     qDebug() << this->metaObject()->className() << "construction";
 
+    metadataHedgeTimer = new QTimer(this);
+    metadataHedgeTimer->setSingleShot(true);
+    connect(
+        metadataHedgeTimer, &QTimer::timeout,
+        this, &ReleaseManager::downloadMetadataUrlsFromNextHost);
+
+    // NOTE: retries are timers, so that a refresh can
+    // tell that a retry is pending
+    metadataUrlsRetryTimer = new QTimer(this);
+    metadataUrlsRetryTimer->setSingleShot(true);
+    metadataUrlsRetryTimer->setInterval(10000);
+    connect(
+        metadataUrlsRetryTimer, &QTimer::timeout,
+        this, &ReleaseManager::downloadMetadataUrls);
+
+    metadataRetryTimer = new QTimer(this);
+    metadataRetryTimer->setSingleShot(true);
+    metadataRetryTimer->setInterval(10000);
+    connect(
+        metadataRetryTimer, &QTimer::timeout,
+        this, &ReleaseManager::downloadMetadata);
+
     sourceModel = new ReleaseModel(this);
     filterModel = new ReleaseFilterModel(sourceModel, this);
 
     // Add custom release to first position
     Release *customRelease = Release::custom(this);
-    addReleaseToModel(0, customRelease);
+    sourceModel->insertReleases(0, {customRelease});
     setSelectedIndex(0);
 
-    QTimer::singleShot(0, this, &ReleaseManager::downloadMetadataUrls);
-}
+    // Release that was kept because it was selected can
+    // be removed now
+    connect(
+        this, &ReleaseManager::selectedChanged,
+        this, &ReleaseManager::removeStale, Qt::QueuedConnection);
 
-void ReleaseManager::downloadMetadataUrls() {
-    qDebug() << "Downloading metadata urls";
+    connect(
+        DriveManager::instance(), &DriveManager::selectedChanged,
+        this, [this]() {
+            Release *release = selected();
 
-    setDownloadingMetadata(true);
+            if (release != nullptr) {
+                release->updateEstimates();
+            }
+        });
 
-    const QList<QString> url_list = get_metadata_urls_list(METADATA_URLS_HOST);
+    catalogParser = CatalogParser::create();
+    connect(
+        catalogParser, &CatalogParser::fileParsed,
+        this, &ReleaseManager::onFileParsed);
+    connect(
+        catalogParser, &CatalogParser::catalogParsed,
+        this, &ReleaseManager::onCachedCatalogParsed);
 
-    metadata_urls_reply_group = new NetworkReplyGroup(url_list, this);
+    loadCachedCatalog();
 
-    connect(
-        metadata_urls_reply_group, &NetworkReplyGroup::finished,
-        this, &ReleaseManager::onMetadataUrlsDownloaded);
+    QTimer::singleShot(0, this, &ReleaseManager::downloadMetadataUrls);
+
+    // Check for new images from time to time
+    const int refresh_interval = settings_metadata_refresh_interval();
+    if (refresh_interval > 0) {
+        auto refresh_timer = new QTimer(this);
+        connect(
+            refresh_timer, &QTimer::timeout,
+            this, &ReleaseManager::refreshMetadata);
+        refresh_timer->start(refresh_interval);
+    }
 }
 
-// TODO: remove usage of backup when metadata urls
-// start getting hosted on getalt
-//
-// NOTE: code duplication for downloading metadata urls
-// is ok because this code is temporary and will be
-// completely removed in the future
-void ReleaseManager::onMetadataUrlsDownloaded() {
-    const QHash<QString, QNetworkReply *> replies = metadata_urls_reply_group->get_reply_list();
-    
-    // Check that all replies suceeded
-    // If not, retry
-    for (const QNetworkReply *reply : replies.values()) {
-        // NOTE: ignore ContentNotFoundError for
-        // metadata since it can happen if one of
-        // the files was moved or renamed. In that
-        // case it's fine to process other
-        // downloads and ignore this failed one.
-        const QNetworkReply::NetworkError error = reply->error();
-        const bool download_failed = (error != QNetworkReply::NoError);
-
-        // Attempt to download from backup host if this
-        // one fails
-        // 
-        // TODO: when usage of backup is removed, fail
-        // and restart here
-        if (download_failed) {
-            qDebug() << "Failed to download metadata urls:" << reply->errorString() << reply->error() << "Downloading from backup";
-            QTimer::singleShot(100, this, &ReleaseManager::downloadMetadataUrlsBackup);
-
-            delete metadata_urls_reply_group;
-            metadata_urls_reply_group = nullptr;
-
-            return;
-        }
-    }
-
-    qDebug() << "Downloaded metadata urls";
-    qDebug() << "Saving metadata urls";
+// NOTE: with the metadata cache, only files that
+// changed are downloaded again
+void ReleaseManager::refreshMetadata() {
+    const bool downloading = (!metadata_urls_reply_groups.isEmpty() || metadata_reply_group != nullptr);
+    const bool retry_pending = (metadataUrlsRetryTimer->isActive() || metadataRetryTimer->isActive());
+    if (downloading || retry_pending) {
+        return;
+    }
 
-    // Collect results
-    QHash<QString, QList<QString>> url_to_data;
+    qDebug() << "Refreshing metadata";
 
-    for (const QString &url : replies.keys()) {
-        QNetworkReply *reply = replies[url];
+    // NOTE: MD5SUM's might have changed too, they are
+    // revalidated next time they are needed
+    Md5sumFetcher::instance()->clear();
 
-        if (reply->error() == QNetworkReply::NoError) {
-            url_to_data[url] = [&]() {
-                const QByteArray bytes = reply->readAll();
-                const QString string = QString(bytes);
-                QList<QString> out = string.split("\n");
-                // Remove last empty line, if there's one
-                out.removeAll("");
+    downloadMetadataUrls();
+}
 
-                return out;
-            }();
+// Shows the catalog from the last time it was downloaded,
+// it is revalidated in the background. If nothing was
+// downloaded yet, shows the catalog built into the app,
+// so that there is something to pick from on the first
+// start without network.
+void ReleaseManager::loadCachedCatalog() {
+    const MetadataSnapshot cached_snapshot = metadata_cache_load_snapshot();
+    const bool have_cached = (!cached_snapshot.section_urls.isEmpty() && !cached_snapshot.image_urls.isEmpty());
+
+    const MetadataSnapshot snapshot = [&]() {
+        if (have_cached) {
+            return cached_snapshot;
         } else {
-            qDebug() << "Failed to download metadata from" << url;
-            qDebug() << "Error:" << reply->error();
+            return metadata_cache_load_builtin_snapshot();
         }
-    }
+    }();
 
-    const QList<QString> url_list = get_metadata_urls_list(METADATA_URLS_HOST);
-    const QString section_metadata_url = url_list[0];
-    const QString image_metadata_url = url_list[1];
-    
-    if (url_to_data.contains(section_metadata_url)) {
-        section_urls = url_to_data[section_metadata_url];
+    if (snapshot.section_urls.isEmpty() || snapshot.image_urls.isEmpty()) {
+        return;
     }
-    if (url_to_data.contains(image_metadata_url)) {
-        image_urls = url_to_data[image_metadata_url];
+
+    if (have_cached) {
+        qDebug() << "Loading cached catalog";
+    } else {
+        qDebug() << "Loading built-in catalog";
     }
 
-    const bool success = (!section_urls.isEmpty() && !image_urls.isEmpty());
+    QList<CatalogSource> sources;
 
-    delete metadata_urls_reply_group;
-    metadata_urls_reply_group = nullptr;
+    const auto add_sources = [&](const QList<QString> &url_list, const CatalogFileType type) {
+        for (const QString &url : url_list) {
+            const QByteArray bytes = [&]() {
+                if (have_cached) {
+                    return metadata_cache_get(url);
+                } else {
+                    return metadata_cache_get_builtin(url);
+                }
+            }();
 
-    if (success) {
-        qDebug() << "Processed metadata urls";
-        qDebug() << "section_urls = " << section_urls;
-        qDebug() << "image_urls = " << image_urls;
+            sources.append({url, type, bytes});
+        }
+    };
 
-        downloadMetadata();
-    } else {
-        qDebug() << "Metadata urls are invalid or empty";
+    add_sources(snapshot.section_urls, CatalogFileType_SECTIONS);
+    add_sources(snapshot.image_urls, CatalogFileType_IMAGES);
+
+    catalogParser->requestCatalog(sources);
+}
+
+void ReleaseManager::onCachedCatalogParsed(const QList<CatalogFile> &files) {
+    // NOTE: downloaded catalog might have gotten ahead
+    // of the cached one, then cached one is not needed
+    if (catalogLoaded || loadedSectionsCount > 0) {
+        return;
     }
+
+    loadCatalog(files);
+
+    catalogLoaded = true;
+    catalogHash = catalog_hash(files);
+
+    setDownloadingMetadata(false);
 }
 
-void ReleaseManager::downloadMetadataUrlsBackup() {
-    qDebug() << "Downloading metadata urls backup";
+// NOTE: metadata urls are requested from all hosts,
+// starting with the one that answered fastest before.
+// Other hosts are requested after a short delay, or
+// right away if a host fails. First valid answer is used
+// and other requests are cancelled.
+//
+// TODO: remove usage of backup when metadata urls
+// start getting hosted on getalt
+void ReleaseManager::downloadMetadataUrls() {
+    qDebug() << "Downloading metadata urls";
 
-    const QList<QString> url_list = get_metadata_urls_list(METADATA_URLS_BACKUP_HOST);
-    
-    metadata_urls_backup_reply_group = new NetworkReplyGroup(url_list, this);
+    metadataTraceStartTime = trace_now();
 
-    connect(
-        metadata_urls_backup_reply_group, &NetworkReplyGroup::finished,
-        this, &ReleaseManager::onMetadataUrlsBackupDownloaded);
+    // NOTE: cached catalog is usable while it's being
+    // revalidated
+    if (!catalogLoaded) {
+        setDownloadingMetadata(true);
+    }
+
+    pendingMetadataHosts = [this]() {
+        QList<QString> out = metadata_hosts();
+
+        // NOTE: hosts that weren't contacted yet go
+        // after the ones that were, in default order
+        std::stable_sort(out.begin(), out.end(),
+            [](const QString &a, const QString &b) {
+                const qint64 latency_a = throughput_latency(a);
+                const qint64 latency_b = throughput_latency(b);
+
+                if (latency_a == 0 || latency_b == 0) {
+                    return (latency_a != 0 && latency_b == 0);
+                } else {
+                    return (latency_a < latency_b);
+                }
+            });
+
+        return out;
+    }();
+
+    metadataUrlsTimer.start();
+    downloadMetadataUrlsFromNextHost();
 }
 
-void ReleaseManager::onMetadataUrlsBackupDownloaded() {
-    const QHash<QString, QNetworkReply *> replies = metadata_urls_backup_reply_group->get_reply_list();
-    
-    // Check that all replies suceeded
-    // If not, retry
-    for (const QNetworkReply *reply : replies.values()) {
-        // NOTE: ignore ContentNotFoundError for
-        // metadata since it can happen if one of
-        // the files was moved or renamed. In that
-        // case it's fine to process other
-        // downloads and ignore this failed one.
-        const QNetworkReply::NetworkError error = reply->error();
-        const bool download_failed = (error != QNetworkReply::NoError);
+void ReleaseManager::downloadMetadataUrlsFromNextHost() {
+    if (pendingMetadataHosts.isEmpty()) {
+        return;
+    }
 
-        if (download_failed) {
-            qDebug() << "Failed to download metadata urls:" << reply->errorString() << reply->error() << "Retrying in 10 seconds.";
-            QTimer::singleShot(10000, this, &ReleaseManager::downloadMetadataUrls);
+    const QString host = pendingMetadataHosts.takeFirst();
 
-            delete metadata_urls_backup_reply_group;
-            metadata_urls_backup_reply_group = nullptr;
+    qDebug() << "Downloading metadata urls from" << host;
 
-            return;
-        }
+    const QList<QString> url_list = get_metadata_urls_list(host);
+    NetworkReplyGroup *group = new NetworkReplyGroup(url_list, this);
+    metadata_urls_reply_groups[host] = group;
+    metadataUrlsStartTimes[host] = metadataUrlsTimer.elapsed();
+
+    connect(
+        group, &NetworkReplyGroup::finished,
+        this, [this, host]() {
+            onMetadataUrlsDownloaded(host);
+        });
+
+    // Hedge with the next host if this one is slow.
+    // Wait for about as long as this host usually
+    // takes.
+    if (!pendingMetadataHosts.isEmpty()) {
+        const qint64 latency = throughput_latency(host);
+        const int hedge_delay = [latency]() {
+            if (latency > 0) {
+                return (int) qBound((qint64) 100, latency * 2, (qint64) 1000);
+            } else {
+                return 300;
+            }
+        }();
+
+        metadataHedgeTimer->start(hedge_delay);
     }
+}
 
-    qDebug() << "Downloaded metadata urls";
-    qDebug() << "Saving metadata urls";
+void ReleaseManager::onMetadataUrlsDownloaded(const QString &host) {
+    NetworkReplyGroup *group = metadata_urls_reply_groups.take(host);
+    const QHash<QString, QNetworkReply *> replies = group->get_reply_list();
+
+    const qint64 latency = metadataUrlsTimer.elapsed() - metadataUrlsStartTimes[host];
+
+    // NOTE: group is deleted later because this is
+    // called from its signal
+    group->deleteLater();
 
     // Collect results
     QHash<QString, QList<QString>> url_to_data;
+    bool download_failed = false;
 
     for (const QString &url : replies.keys()) {
         QNetworkReply *reply = replies[url];
 
         if (reply->error() == QNetworkReply::NoError) {
             url_to_data[url] = [&]() {
-                const QByteArray bytes = reply->readAll();
+                const QByteArray bytes = metadata_cache_read(reply);
                 const QString string = QString(bytes);
                 QList<QString> out = string.split("\n");
+                // Remove last empty line, if there's one
                 out.removeAll("");
 
                 return out;
             }();
         } else {
-            qDebug() << "Failed to download metadata from" << url;
-            qDebug() << "Error:" << reply->error();
+            qDebug() << "Failed to download metadata urls from" << url << reply->errorString() << reply->error();
+            download_failed = true;
         }
     }
 
-    const QList<QString> url_list = get_metadata_urls_list(METADATA_URLS_BACKUP_HOST);
-    const QString section_metadata_url = url_list[0];
-    const QString image_metadata_url = url_list[1];
-    
-    if (url_to_data.contains(section_metadata_url)) {
-        section_urls = url_to_data[section_metadata_url];
-    }
-    if (url_to_data.contains(image_metadata_url)) {
-        image_urls = url_to_data[image_metadata_url];
-    }
+    const QList<QString> url_list = get_metadata_urls_list(host);
+    const QList<QString> new_section_urls = url_to_data.value(url_list[0]);
+    const QList<QString> new_image_urls = url_to_data.value(url_list[1]);
 
-    const bool success = (!section_urls.isEmpty() && !image_urls.isEmpty());
+    const bool success = (!download_failed && !new_section_urls.isEmpty() && !new_image_urls.isEmpty());
 
-    delete metadata_urls_backup_reply_group;
-    metadata_urls_backup_reply_group = nullptr;
+    if (!success) {
+        qDebug() << "Metadata urls from" << host << "are invalid or empty";
 
-    if (success) {
-        qDebug() << "Processed metadata urls";
-        qDebug() << "section_urls = " << section_urls;
-        qDebug() << "image_urls = " << image_urls;
+        // NOTE: failures count as slow answers, so
+        // that a broken host is tried last next time
+        throughput_record_latency(host, qMax(latency, (qint64) 5000));
 
-        downloadMetadata();
-    } else {
-        qDebug() << "Metadata urls are invalid or empty";
+        // Try next host right away
+        if (!pendingMetadataHosts.isEmpty()) {
+            metadataHedgeTimer->stop();
+            downloadMetadataUrlsFromNextHost();
+        } else if (metadata_urls_reply_groups.isEmpty()) {
+            qDebug() << "Failed to download metadata urls from all hosts. Retrying in 10 seconds.";
+            metadataUrlsRetryTimer->start();
+        }
+
+        return;
     }
+
+    throughput_record_latency(host, latency);
+
+    // Cancel other hosts
+    metadataHedgeTimer->stop();
+    pendingMetadataHosts.clear();
+    for (NetworkReplyGroup *other_group : metadata_urls_reply_groups) {
+        other_group->disconnect(this);
+        other_group->deleteLater();
+    }
+    metadata_urls_reply_groups.clear();
+
+    section_urls = new_section_urls;
+    image_urls = new_image_urls;
+
+    qDebug() << "Processed metadata urls from" << host << "in" << latency << "ms";
+    qDebug() << "section_urls = " << section_urls;
+    qDebug() << "image_urls = " << image_urls;
+
+    downloadMetadata();
 }
 
+// NOTE: metadata is loaded as a pipeline. Each file is
+// processed as soon as it arrives instead of waiting
+// for all files. Releases are added to the model in
+// the order of sections, variants are added once all
+// releases are loaded. MD5SUM's are not part of the
+// catalog, they are fetched when an image is selected
+// or downloaded, so the number of requests doesn't
+// grow with the catalog.
 void ReleaseManager::downloadMetadata() {
     qDebug() << "Downloading metadata";
 
+    deleteMetadataReplyGroups();
+
+    metadataFiles.clear();
+    loadedImageUrls.clear();
+    loadedSectionsCount = 0;
+
     const QList<QString> all_urls = section_urls + image_urls;
 
     metadata_reply_group = new NetworkReplyGroup(all_urls, this);
 
     connect(
-        metadata_reply_group, &NetworkReplyGroup::finished,
-        this, &ReleaseManager::onMetadataDownloaded);
+        metadata_reply_group, &NetworkReplyGroup::reply_finished,
+        this, &ReleaseManager::onMetadataReplyFinished);
 }
 
-void ReleaseManager::onMetadataDownloaded() {
-    const QHash<QString, QNetworkReply *> replies = metadata_reply_group->get_reply_list();
-    
-    // Check that all replies suceeded
-    // If not, retry
-    for (const QNetworkReply *reply : replies.values()) {
-        // NOTE: ignore ContentNotFoundError for
-        // metadata since it can happen if one of
-        // the files was moved or renamed. In that
-        // case it's fine to process other
-        // downloads and ignore this failed one.
-        const QNetworkReply::NetworkError error = reply->error();
-        const bool download_failed = (error != QNetworkReply::NoError && error != QNetworkReply::ContentNotFoundError);
+void ReleaseManager::onMetadataReplyFinished(const QString &url) {
+    QNetworkReply *reply = metadata_reply_group->get_reply_list()[url];
 
-        if (download_failed) {
-            qDebug() << "Failed to download metadata:" << reply->errorString() << reply->error() << "Retrying in 10 seconds.";
-            QTimer::singleShot(10000, this, &ReleaseManager::downloadMetadata);
+    // NOTE: ignore ContentNotFoundError for
+    // metadata since it can happen if one of
+    // the files was moved or renamed. In that
+    // case it's fine to process other
+    // downloads and ignore this failed one.
+    const QNetworkReply::NetworkError error = reply->error();
+    const bool download_failed = (error != QNetworkReply::NoError && error != QNetworkReply::ContentNotFoundError);
 
-            delete metadata_reply_group;
-            metadata_reply_group = nullptr;
+    if (download_failed) {
+        qDebug() << "Failed to download metadata:" << reply->errorString() << reply->error() << "Retrying in 10 seconds.";
+        abortMetadataDownload();
 
-            return;
-        }
+        return;
     }
 
-    qDebug() << "Downloaded metadata, loading it";
-
-    // Collect results
-    QHash<QString, QString> url_to_file;
-
-    for (const QString &url : replies.keys()) {
-        QNetworkReply *reply = replies[url];
+    if (error != QNetworkReply::NoError) {
+        qDebug() << "Failed to download metadata from" << url;
+        qDebug() << "Error:" << reply->error();
+    }
 
-        if (reply->error() == QNetworkReply::NoError) {
-            const QByteArray bytes = reply->readAll();
-            url_to_file[url] = QString(bytes);
+    const CatalogFileType type = [&]() {
+        if (section_urls.contains(url)) {
+            return CatalogFileType_SECTIONS;
         } else {
-            qDebug() << "Failed to download metadata from" << url;
-            qDebug() << "Error:" << reply->error();
+            return CatalogFileType_IMAGES;
         }
-    }
-
-    const QList<QString> sectionsFiles = [&]() {
-        QList<QString> out;
+    }();
 
-        for (const QString &section_url : section_urls) {
-            const QString section = url_to_file[section_url];
-            out.append(section);
+    const QByteArray bytes = [&]() {
+        if (error == QNetworkReply::NoError) {
+            return metadata_cache_read(reply);
+        } else {
+            return QByteArray();
         }
-        return out;
     }();
 
-    qDebug() << "Loading releases";
+    catalogParser->requestFile({url, type, bytes});
+}
 
-    loadReleases(sectionsFiles);
+void ReleaseManager::onFileParsed(const CatalogFile &file) {
+    // Download was aborted while this file was parsed
+    if (metadata_reply_group == nullptr) {
+        return;
+    }
 
-    imagesFiles = [&]() {
-        QList<QString> out;
+    metadataFiles[file.url] = file;
 
-        for (const QString &image_url : image_urls) {
-            const QString image = url_to_file[image_url];
-            out.append(image);
+    loadReadyMetadata();
+}
+
+// Loads everything that can be loaded with files
+// parsed so far
+void ReleaseManager::loadReadyMetadata() {
+    // NOTE: if catalog was loaded from cache, it is
+    // replaced only after everything is downloaded
+    while (loadedSectionsCount < section_urls.size() && metadataFiles.contains(section_urls[loadedSectionsCount])) {
+        if (!catalogLoaded) {
+            const CatalogFile &section = metadataFiles[section_urls[loadedSectionsCount]];
+            loadReleases(section.releases);
         }
-        return out;
-    }();
 
-    // NOTE: images/variants are loaded later after
-    // md5sum is downloaded
+        loadedSectionsCount++;
+    }
 
-    delete metadata_reply_group;
-    metadata_reply_group = nullptr;
+    // Variants are matched to releases by name, so all
+    // releases need to be loaded first
+    const bool all_sections_loaded = (loadedSectionsCount == section_urls.size());
+    if (!all_sections_loaded) {
+        return;
+    }
 
-    const QList<QString> md5sum_url_list = [&]() {
-        const QList<QString> image_url_list = [&]() {
-            QList<QString> out;
+    for (const QString &image_url : image_urls) {
+        const bool ready = (!loadedImageUrls.contains(image_url) && metadataFiles.contains(image_url));
 
-            for (const QString &imagesFile : imagesFiles) {
-                YAML::Node variants = YAML::Load(imagesFile.toStdString());
+        if (!ready) {
+            continue;
+        }
 
-                if (!variants["entries"]) {
-                    continue;
-                }
+        if (!catalogLoaded) {
+            const CatalogFile &images = metadataFiles[image_url];
 
-                for (const YAML::Node &variantData : variants["entries"]) {
-                    const QString url = yml_get(variantData, "link");
-                    out.append(url);
-                }
-            }
+            loadVariants(images.variants);
+        }
 
-            return out;
-        }();
+        loadedImageUrls.insert(image_url);
+    }
 
-        const QList<QString> out = [&]() {
-            // NOTE: using set because there will be
-            // duplicates due to there being multiple
-            // images per folder
-            QSet<QString> out_set;
+    // NOTE: QSet::fromList() is deprecated in newer Qt
+    const bool all_images_loaded = [this]() {
+        for (const QString &image_url : image_urls) {
+            if (!loadedImageUrls.contains(image_url)) {
+                return false;
+            }
+        }
 
-            for (const QString &image_url : image_url_list) {
-                // TODO: duplicating code in
-                // image_download.cpp
-                const QString md5sum_url = QUrl(image_url).adjusted(QUrl::RemoveFilename).toString() + "/MD5SUM";
+        return true;
+    }();
+    if (all_images_loaded) {
+        onMetadataLoaded();
+    }
+}
 
-                out_set.insert(md5sum_url);
-            }
+void ReleaseManager::onMetadataLoaded() {
+    qDebug() << "Downloaded metadata";
 
-            const QList<QString> out = out_set.toList();
+    trace_async_span("Download metadata", "metadata", metadataTraceStartTime);
+    trace_memory();
 
-            return out;
-        }();
+    // NOTE: same order as in the cached catalog
+    const QList<CatalogFile> files = [&]() {
+        QList<CatalogFile> out;
+
+        for (const QString &url : section_urls + image_urls) {
+            out.append(metadataFiles[url]);
+        }
 
         return out;
     }();
 
-    downloadMD5SUM(md5sum_url_list);
-}
-
-void ReleaseManager::downloadMD5SUM(const QList<QString> &md5sum_url_list) {
-    qDebug() << "Downloading MD5SUM's";
+    const QByteArray new_catalog_hash = catalog_hash(files);
 
-    md5sum_reply_group = new NetworkReplyGroup(md5sum_url_list, this);
+    // NOTE: if catalog wasn't loaded from cache, then
+    // releases and variants were already loaded while
+    // downloading
+    if (catalogLoaded) {
+        if (new_catalog_hash != catalogHash) {
+            qDebug() << "Catalog changed, updating it";
 
-    connect(
-        md5sum_reply_group, &NetworkReplyGroup::finished,
-        this, &ReleaseManager::onMD5SUMDownloaded);
-}
+            updateCatalog(files);
+        } else {
+            qDebug() << "Catalog didn't change since it was cached";
+        }
+    }
 
-void ReleaseManager::onMD5SUMDownloaded() {
-    const QHash<QString, QNetworkReply *> replies = md5sum_reply_group->get_reply_list();
+    catalogLoaded = true;
+    catalogHash = new_catalog_hash;
 
-    // Check that all replies suceeded
-    // If not, retry
-    // TODO: duplicating code
-    for (const QNetworkReply *reply : replies.values()) {
-        // NOTE: ignore ContentNotFoundError for
-        // metadata since it can happen if one of
-        // the files was moved or renamed. In that
-        // case it's fine to process other
-        // downloads and ignore this failed one.
-        const QNetworkReply::NetworkError error = reply->error();
-        const bool download_failed = (error != QNetworkReply::NoError && error != QNetworkReply::ContentNotFoundError);
+    MetadataSnapshot snapshot;
+    snapshot.section_urls = section_urls;
+    snapshot.image_urls = image_urls;
+    metadata_cache_save_snapshot(snapshot);
 
-        if (download_failed) {
-            qDebug() << "Failed to download md5sum:" << reply->errorString() << reply->error() << "Retrying in 10 seconds.";
-            QTimer::singleShot(10000, this, &ReleaseManager::downloadMetadata);
+    deleteMetadataReplyGroups();
 
-            delete md5sum_reply_group;
-            md5sum_reply_group = nullptr;
+    setDownloadingMetadata(false);
 
-            return;
-        }
+    if (settings_prefetch()) {
+        Prefetcher::instance()->setCandidates(prefetchCandidates());
     }
+}
 
-    qDebug() << "Downloaded md5sum, loading it";
-
-    const QList<QString> md5sum_file_list = [&]() {
-        QList<QString> out;
+// Stops the download and retries it later. Releases
+// that were loaded so far are removed, they will be
+// loaded again by the retry. Releases that are in use
+// are kept and reused by the retry.
+void ReleaseManager::abortMetadataDownload() {
+    deleteMetadataReplyGroups();
 
-        for (const QString &url : replies.keys()) {
-            QNetworkReply *reply = replies[url];
+    if (!catalogLoaded) {
+        for (int i = 1; i < sourceModel->rowCount(); i++) {
+            staleReleases.insert(sourceModel->get(i));
+        }
 
-            if (reply->error() == QNetworkReply::NoError) {
-                const QByteArray bytes = reply->readAll();
-                const QString string = QString(bytes);
-                out.append(string);
-            } else {
-                qDebug() << "Failed to download metadata from" << url;
-                qDebug() << "Error:" << reply->error();
-            }
+        if (m_selectedIndex != 0) {
+            m_selectedIndex = 0;
+            emit selectedChanged();
         }
 
-        return out;
-    }();
+        removeStale();
+    }
 
-    const QHash<QString, QString> md5sum_map = [&]() {
-        QHash<QString, QString> out;
+    metadataRetryTimer->start();
+}
 
-        for (const QString &file : md5sum_file_list) {
-            const QList<QString> line_list = file.split("\n");
+// NOTE: groups are deleted later because this can be
+// called from their signals
+void ReleaseManager::deleteMetadataReplyGroups() {
+    if (metadata_reply_group != nullptr) {
+        metadata_reply_group->disconnect(this);
+        metadata_reply_group->deleteLater();
+    }
 
-            // MD5SUM is of the form "sum image \n sum
-            // image \n ..."
-            for (const QString &line : line_list) {
-                const QList<QString> elements = line.split(QRegExp("\\s+"));
+    metadata_reply_group = nullptr;
+}
 
-                if (elements.size() != 2) {
-                    continue;
-                }
+// Releases on the front page are the most likely to be
+// picked, prefetch their variants for this machine's
+// architecture
+QList<Variant *> ReleaseManager::prefetchCandidates() const {
+    const Architecture host_arch = architecture_host();
+    QList<Variant *> out;
 
-                const QString md5sum = elements[0];
-                const QString filename = elements[1];
+    for (int i = 0; i < sourceModel->rowCount(); i++) {
+        const bool on_front_page = ReleaseFilterModel::isOnFrontPage(i);
 
-                out[filename] = md5sum;
-            }
+        Release *release = sourceModel->get(i);
+        if (!on_front_page || release->isCustom()) {
+            continue;
         }
 
-        return out;
-    }();
-
-    qDebug() << "Loading variants";
+        for (Variant *variant : release->variantList()) {
+            if (variant->arch() == host_arch && variant->canWrite()) {
+                out.append(variant);
 
-    for (const QString &imagesFile : imagesFiles) {
-        loadVariants(imagesFile, md5sum_map);
+                break;
+            }
+        }
     }
 
-    delete md5sum_reply_group;
-    md5sum_reply_group = nullptr;
-
-    setDownloadingMetadata(false);
+    return out;
 }
 
 void ReleaseManager::setDownloadingMetadata(const bool value) {
@@ -503,6 +638,20 @@ void ReleaseManager::setSelectedIndex(const int index) {
     if (m_selectedIndex != row_source) {
         m_selectedIndex = row_source;
         emit selectedChanged();
+
+        // Find out image sizes of the release that is
+        // now in view, for all variants at once
+        Release *release = selected();
+        if (release != nullptr) {
+            for (Variant *variant : release->variantList()) {
+                variant->probe();
+                variant->fetchMd5sum();
+            }
+
+            // Drive might have changed while another
+            // release was selected
+            release->updateEstimates();
+        }
     }
 }
 
@@ -510,92 +659,40 @@ ReleaseFilterModel *ReleaseManager::getFilterModel() const {
     return filterModel;
 }
 
-void ReleaseManager::loadVariants(const QString &variantsFile, const QHash<QString, QString> &md5sum_map) {
-    YAML::Node variants = YAML::Load(variantsFile.toStdString());
-
-    if (!variants["entries"]) {
-        return;
-    }
-
-    for (const YAML::Node &variantData : variants["entries"]) {
-        const QString url = yml_get(variantData, "link");
-        if (url.isEmpty()) {
-            qDebug() << "Variant has no url";
-            continue;
-        }
-
-        const QString releaseName = yml_get(variantData, "solution");
-        if (releaseName.isEmpty()) {
-            qDebug() << "Variant has no releaseName" << url;
-            continue;
-        }
-
-        const QString arch_string = yml_get(variantData, "arch");
-        const Architecture arch = [arch_string, url]() -> Architecture {
-            if (!arch_string.isEmpty()) {
-                return architecture_from_string(arch_string);
-            } else {
-                return architecture_from_filename(url);
-            }
-        }();
-        if (arch == Architecture_UNKNOWN) {
-            qDebug() << "Variant has unknown architecture" << arch_string << url;
-            continue;
-        }
-
-        // NOTE: yml file doesn't define "board" for pc32/pc64, so default to "PC"
-        const QString board = [variantData]() -> QString {
-            const QString out = yml_get(variantData, "board");
-            if (!out.isEmpty()) {
-                return out;
-            } else {
-                return "PC";
-            }
-        }();
+void ReleaseManager::loadVariants(const QList<CatalogVariant> &variants) {
+    const qint64 trace_start_time = trace_now();
 
-        const FileType fileType = file_type_from_filename(url);
-        if (fileType == FileType_UNKNOWN) {
-            qDebug() << "Variant has unknown file type" << url;
-            continue;
-        }
+    for (const CatalogVariant &data : variants) {
+        Release *release = sourceModel->find(data.release_name);
 
-        const bool live = [variantData]() {
-            const QString live_string = yml_get(variantData, "live");
-            if (!live_string.isEmpty()) {
-                return (live_string == "1");
-            } else {
+        // Variant was kept after an aborted download
+        // because it was in use
+        const bool already_loaded = [&]() {
+            if (release == nullptr) {
                 return false;
             }
-        }();
-
-        const QString md5sum = [&]() {
-            const QString filename = QUrl(url).fileName();
-            const QString out = md5sum_map[filename];
 
-            return out;
-        }();
-
-        // qDebug() << QUrl(url).fileName() << releaseName << architecture_name(arch) << board << file_type_name(fileType) << (live ? "LIVE" : "");
-
-        // Find a release that has the same name as this variant
-        Release *release = [this, releaseName]() -> Release * {
-            for (int i = 0; i < sourceModel->rowCount(); i++) {
-                Release *release = sourceModel->get(i);
-
-                if (release->name() == releaseName) {
-                    return release;
+            for (const Variant *variant : release->variantList()) {
+                if (variant->url() == data.url) {
+                    return true;
                 }
             }
-            return nullptr;
+
+            return false;
         }();
 
-        if (release != nullptr) {
-            Variant *variant = new Variant(url, arch, fileType, board, live, md5sum, this);
+        if (already_loaded) {
+            continue;
+        } else if (release != nullptr) {
+            Variant *variant = new Variant(data.url, mirrorPaths, data.arch, data.file_type, data.board, data.live, this);
             release->addVariant(variant);
         } else {
-            qDebug() << "Failed to find a release for this variant!" << url;
+            qDebug() << "Failed to find a release for this variant!" << data.url;
         }
     }
+
+    trace_span("Load variants", "model", trace_start_time, {{"count", variants.size()}});
+    trace_memory();
 }
 
 QStringList ReleaseManager::architectures() const {
@@ -651,105 +748,298 @@ QStringList ReleaseManager::fileTypeFilters() const {
     return filters;
 }
 
-void ReleaseManager::loadReleases(const QList<QString> &sectionsFiles) {
-    for (const QString &sectionFile : sectionsFiles) {
-        const YAML::Node section = YAML::Load(sectionFile.toStdString());
+void ReleaseManager::loadReleases(const QList<CatalogRelease> &releases) {
+    const qint64 trace_start_time = trace_now();
+
+    QList<Release *> batch;
+
+    for (const CatalogRelease &data : releases) {
+        // Release was kept after an aborted download
+        // because it was in use
+        Release *existing_release = sourceModel->find(data.name);
+        if (existing_release != nullptr) {
+            staleReleases.remove(existing_release);
 
-        if (!section["members"]) {
             continue;
         }
 
-        for (unsigned int i = 0; i < section["members"].size(); i++) {
-            const YAML::Node releaseData = section["members"][i];
+        // NOTE: currently no screenshots
+        const QStringList screenshots;
+
+        const auto release = new Release(data.name, data.display_name, data.summary, data.description, data.icon_path, screenshots, this);
+
+        // Reorder releases because default order in
+        // sections files is not good. Try to put
+        // workstation first after custom release and
+        // server second, so that they are both on the
+        // frontpage. Other releases are added in one
+        // batch.
+        const QString release_name = release->name();
+        const bool is_workstation = (release_name == "alt-workstation");
+        const bool is_kworkstation = (release_name == "alt-kworkstation");
+
+        if (is_workstation) {
+            sourceModel->insertReleases(1, {release});
+        } else if (is_kworkstation) {
+            sourceModel->insertReleases(2, {release});
+        } else {
+            batch.append(release);
+        }
+    }
+
+    sourceModel->insertReleases(sourceModel->rowCount(), batch);
+
+    // NOTE: rows that were moved off the front page by
+    // insertions need to be filtered again
+    filterModel->invalidateCustom();
+
+    trace_span("Load releases", "model", trace_start_time, {{"count", releases.size()}});
+}
+
+// Loads releases from all sections files, then variants
+// from all images files
+void ReleaseManager::loadCatalog(const QList<CatalogFile> &files) {
+    for (const CatalogFile &file : files) {
+        if (file.type == CatalogFileType_SECTIONS) {
+            loadReleases(file.releases);
+        }
+    }
+
+    for (const CatalogFile &file : files) {
+        if (file.type == CatalogFileType_IMAGES) {
+            loadVariants(file.variants);
+        }
+    }
+}
+
+// Applies changes in the catalog to the model: removes
+// releases and variants that are gone, updates details of
+// releases and variants, adds new releases and variants.
+// Variants are matched by url.
+void ReleaseManager::updateCatalog(const QList<CatalogFile> &files) {
+    const qint64 trace_start_time = trace_now();
+
+    Release *selected_release = selected();
+
+    QList<CatalogRelease> new_releases;
+    QHash<QString, QList<CatalogVariant>> new_variants;
+
+    for (const CatalogFile &file : files) {
+        new_releases.append(file.releases);
+
+        for (const CatalogVariant &variant : file.variants) {
+            new_variants[variant.release_name].append(variant);
+        }
+    }
+
+    const QSet<QString> new_release_names = [&]() {
+        QSet<QString> out;
+
+        for (const CatalogRelease &data : new_releases) {
+            out.insert(data.name);
+        }
+
+        return out;
+    }();
+
+    // Mark removed releases, custom release is always
+    // first and stays. Release that was removed before
+    // might have come back.
+    for (int i = 1; i < sourceModel->rowCount(); i++) {
+        Release *release = sourceModel->get(i);
+
+        if (new_release_names.contains(release->name())) {
+            staleReleases.remove(release);
+        } else {
+            staleReleases.insert(release);
+        }
+    }
+
+    // Update and add releases
+    const QList<CatalogRelease> added_releases = [&]() {
+        QList<CatalogRelease> out;
+
+        for (const CatalogRelease &data : new_releases) {
+            Release *release = sourceModel->find(data.name);
+
+            if (release != nullptr) {
+                release->setDetails(data.display_name, data.summary, data.description, data.icon_path);
+            } else {
+                qDebug() << "Adding release" << data.name;
+                out.append(data);
+            }
+        }
+
+        return out;
+    }();
+    loadReleases(added_releases);
+
+    // Update variants
+    for (int i = 1; i < sourceModel->rowCount(); i++) {
+        Release *release = sourceModel->get(i);
+        if (staleReleases.contains(release)) {
+            continue;
+        }
+
+        const QList<CatalogVariant> variant_list = new_variants.value(release->name());
+
+        const QHash<QString, CatalogVariant> url_to_variant = [&]() {
+            QHash<QString, CatalogVariant> out;
+
+            for (const CatalogVariant &data : variant_list) {
+                out[data.url] = data;
+            }
+
+            return out;
+        }();
+
+        for (Variant *variant : release->variantList()) {
+            if (!url_to_variant.contains(variant->url())) {
+                staleVariants.insert(variant);
 
-            const QString name = yml_get(releaseData, "code");
-            if (name.isEmpty()) {
-                qDebug() << "Release has no name";
                 continue;
             }
 
-            const QString language = []() {
-                if (QLocale().language() == QLocale::Russian) {
-                    return "_ru";
-                } else {
-                    return "_en";
+            staleVariants.remove(variant);
+
+            const CatalogVariant data = url_to_variant[variant->url()];
+            variant->update(data.arch, data.file_type, data.board, data.live);
+
+            // NOTE: size is shown for the selected
+            // release, find it out again if it was reset
+            if (release == selected_release) {
+                variant->probe();
+            }
+        }
+
+        const QList<CatalogVariant> added_variants = [&]() {
+            QList<CatalogVariant> out;
+
+            const QSet<QString> current_urls = [&]() {
+                QSet<QString> urls;
+
+                for (const Variant *variant : release->variantList()) {
+                    urls.insert(variant->url());
                 }
+
+                return urls;
             }();
 
-            const QString display_name = yml_get(releaseData, "name" + language);
-            if (display_name.isEmpty()) {
-                qDebug() << "Release has no display name";
-                continue;
+            for (const CatalogVariant &data : variant_list) {
+                if (!current_urls.contains(data.url)) {
+                    out.append(data);
+                }
             }
 
-            const QString summary = yml_get(releaseData, "descr" + language);
-            if (summary.isEmpty()) {
-                qDebug() << "Release has no summary";
-                continue;
-            }
+            return out;
+        }();
+        loadVariants(added_variants);
+    }
+
+    // Rows might have moved
+    updateSelectedIndex(selected_release);
+
+    removeStale();
+
+    trace_span("Update catalog", "model", trace_start_time);
+}
+
+// Removes releases and variants that are no longer in
+// the catalog. Releases and variants that are being
+// downloaded or written, and the selected release, are
+// kept until they aren't, so that the user doesn't lose
+// them.
+//
+// NOTE: objects are deleted later because QML might
+// still be using them until it handles the removal
+void ReleaseManager::removeStale() {
+    if (staleReleases.isEmpty() && staleVariants.isEmpty()) {
+        return;
+    }
+
+    static const Qt::ConnectionType recheck_connection = (Qt::ConnectionType) (Qt::QueuedConnection | Qt::UniqueConnection);
+
+    Release *selected_release = selected();
+    QList<Release *> removed_releases;
+
+    for (int i = sourceModel->rowCount() - 1; i >= 1; i--) {
+        Release *release = sourceModel->get(i);
+
+        if (staleReleases.contains(release)) {
+            const bool in_use = (release == selected_release || release_is_busy(release));
+
+            if (in_use) {
+                for (Variant *variant : release->variantList()) {
+                    connect(
+                        variant, &Variant::statusChanged,
+                        this, &ReleaseManager::removeStale, recheck_connection);
+                }
 
-            const QString description = yml_get(releaseData, "descr_full" + language);
-            if (description.isEmpty()) {
-                qDebug() << "Release has no description";
                 continue;
             }
 
-            // NOTE: currently no screenshots
-            const QStringList screenshots;
+            qDebug() << "Removing release" << release->name();
+
+            removed_releases.append(release);
+            staleReleases.remove(release);
+
+            continue;
+        }
 
-            // Check that icon file exists
-            const QString icon_name = yml_get(releaseData, "img");
-            if (icon_name.isEmpty()) {
-                qDebug() << "Release has no icon";
+        for (Variant *variant : release->variantList()) {
+            if (!staleVariants.contains(variant)) {
                 continue;
             }
 
-            const QString icon_path_test = ":/logo/" + icon_name;
-            const QFile icon_file(icon_path_test);
-            if (!icon_file.exists()) {
-                qDebug() << "Failed to find icon file at " << icon_path_test << " needed for release " << name;
+            if (variant->isBusy()) {
+                connect(
+                    variant, &Variant::statusChanged,
+                    this, &ReleaseManager::removeStale, recheck_connection);
+
                 continue;
             }
 
-            // NOTE: icon_path is consumed by QML, so it needs to begin with "qrc:/" not ":/"
-            const QString icon_path = "qrc" + icon_path_test;
-
-            const auto release = new Release(name, display_name, summary, description, icon_path, screenshots, this);
-
-            // Reorder releases because default order in
-            // sections files is not good. Try to put
-            // workstation first after custom release and
-            // server second, so that they are both on the
-            // frontpage.
-            const int index = [this, release]() {
-                const QString release_name = release->name();
-                const bool is_workstation = (release_name == "alt-workstation");
-                const bool is_kworkstation = (release_name == "alt-kworkstation");
-
-                if (is_workstation) {
-                    return 1;
-                } else if (is_kworkstation) {
-                    return 2;
-                } else {
-                    return sourceModel->rowCount();
-                }
-            }();
+            qDebug() << "Removing variant" << variant->url();
 
-            addReleaseToModel(index, release);
+            staleVariants.remove(variant);
+            release->removeVariant(variant);
+            variant->deleteLater();
         }
     }
 
-    filterModel->invalidateCustom();
+    // NOTE: releases are removed from the model at once,
+    // so that adjacent rows go in one batch
+    sourceModel->removeReleases(removed_releases);
+
+    for (Release *release : removed_releases) {
+        for (Variant *variant : release->variantList()) {
+            staleVariants.remove(variant);
+            variant->deleteLater();
+        }
+        release->deleteLater();
+    }
+
+    // Rows might have moved
+    updateSelectedIndex(selected_release);
 }
 
-void ReleaseManager::addReleaseToModel(const int index, Release *release) {
-    QVariant variant;
-    variant.setValue(release);
+void ReleaseManager::updateSelectedIndex(Release *selected_release) {
+    const int selected_index = sourceModel->indexOf(selected_release);
 
-    QStandardItem *item = new QStandardItem();
-    item->setData(variant);
+    if (selected_index != m_selectedIndex) {
+        m_selectedIndex = qMax(selected_index, 0);
+        emit selectedChanged();
+    }
+}
+
+bool release_is_busy(const Release *release) {
+    for (const Variant *variant : release->variantList()) {
+        if (variant->isBusy()) {
+            return true;
+        }
+    }
 
-    sourceModel->insertRow(index, item);
+    return false;
 }
 
 QList<QString> load_list_from_file(const QString &filepath) {
@@ -768,20 +1058,16 @@ QList<QString> load_list_from_file(const QString &filepath) {
     return list;
 }
 
-QString yml_get(const YAML::Node &node, const QString &key) {
-    const std::string key_std = key.toStdString();
-    const YAML::Node value_yml = node[key_std];
-    const std::string fallback = std::string();
-    const std::string value_std = value_yml.as<std::string>(fallback);
-    QString value = QString::fromStdString(value_std);
-
-    // Remove HTML character entities that don't render in Qt
-    value.replace("&colon;", ":");
-    value.replace("&nbsp;", " ");
-    // Remove newlines because text will have wordwrap
-    value.replace("\n", " ");
+// NOTE: overriding host replaces both primary and
+// backup hosts, to be able to work with a local server
+QList<QString> metadata_hosts() {
+    const QString override_host = settings_metadata_host();
 
-    return value;
+    if (!override_host.isEmpty()) {
+        return {override_host};
+    } else {
+        return {METADATA_URLS_HOST, METADATA_URLS_BACKUP_HOST};
+    }
 }
 
 // TODO: this f-n might become unneeded when usage of
@@ -789,7 +1075,7 @@ QString yml_get(const YAML::Node &node, const QString &key) {
 QList<QString> get_metadata_urls_list(const QString &host) {
     const QString SECTION_URL_LIST_FILENAME = "altmediawriter_section_url_list.txt";
     const QString IMAGE_URL_LIST_FILENAME = "altmediawriter_image_url_list.txt";
-        
+
     const QList<QString> out = {
         QString("%1/%2").arg(host, SECTION_URL_LIST_FILENAME),
         QString("%1/%2").arg(host, IMAGE_URL_LIST_FILENAME),
@@ -28,13 +28,19 @@
  * the qml portion of the app.
  */
 
+#include "catalog.h"
+
+#include <QElapsedTimer>
 #include <QObject>
 #include <QHash>
+#include <QSet>
 
 class Release;
+class Variant;
 class ReleaseModel;
 class ReleaseFilterModel;
 class NetworkReplyGroup;
+class QTimer;
 
 class ReleaseManager : public QObject {
     Q_OBJECT
@@ -72,25 +78,49 @@ private:
     int m_selectedIndex;
     bool m_downloadingMetadata;
     NetworkReplyGroup *metadata_reply_group;
-    NetworkReplyGroup *metadata_urls_reply_group;
-    NetworkReplyGroup *metadata_urls_backup_reply_group;
-    NetworkReplyGroup *md5sum_reply_group;
+    QHash<QString, NetworkReplyGroup *> metadata_urls_reply_groups;
+    QList<QString> pendingMetadataHosts;
+    QHash<QString, qint64> metadataUrlsStartTimes;
+    QElapsedTimer metadataUrlsTimer;
+    QTimer *metadataHedgeTimer;
+    QTimer *metadataUrlsRetryTimer;
+    QTimer *metadataRetryTimer;
+    qint64 metadataTraceStartTime;
     QList<QString> section_urls;
     QList<QString> image_urls;
-    QList<QString> imagesFiles;
-
-    void loadVariants(const QString &variantsFile, const QHash<QString, QString> &md5sum_map);
+    CatalogParser *catalogParser;
+    QHash<QString, CatalogFile> metadataFiles;
+    QSet<QString> loadedImageUrls;
+    int loadedSectionsCount;
+    bool catalogLoaded;
+    QByteArray catalogHash;
+    QHash<QString, QString> mirrorPaths;
+    // Releases and variants that were removed from the
+    // catalog but are still in use
+    QSet<Release *> staleReleases;
+    QSet<Variant *> staleVariants;
+
+    void loadCachedCatalog();
+    void onCachedCatalogParsed(const QList<CatalogFile> &files);
+    void loadCatalog(const QList<CatalogFile> &files);
+    void updateCatalog(const QList<CatalogFile> &files);
+    void removeStale();
+    void updateSelectedIndex(Release *selected_release);
+    void refreshMetadata();
+    void loadVariants(const QList<CatalogVariant> &variants);
     void setDownloadingMetadata(const bool value);
     void downloadMetadataUrls();
-    void onMetadataUrlsDownloaded();
-    void downloadMetadataUrlsBackup();
-    void onMetadataUrlsBackupDownloaded();
+    void downloadMetadataUrlsFromNextHost();
+    void onMetadataUrlsDownloaded(const QString &host);
     void downloadMetadata();
-    void downloadMD5SUM(const QList<QString> &md5sum_url_list);
-    void loadReleases(const QList<QString> &sectionsFiles);
-    void addReleaseToModel(const int index, Release *release);
-    void onMetadataDownloaded();
-    void onMD5SUMDownloaded();
+    void loadReleases(const QList<CatalogRelease> &releases);
+    void onMetadataReplyFinished(const QString &url);
+    void onFileParsed(const CatalogFile &file);
+    void loadReadyMetadata();
+    void onMetadataLoaded();
+    void abortMetadataDownload();
+    void deleteMetadataReplyGroups();
+    QList<Variant *> prefetchCandidates() const;
 };
 
 #endif // RELEASEMANAGER_H
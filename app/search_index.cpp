@@ -0,0 +1,213 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include "search_index.h"
+#include "release.h"
+#include "variant.h"
+
+#include <QRegExp>
+#include <QStringList>
+
+// NOTE: words that match less than this part of query
+// word's trigrams don't match
+static const qreal match_ratio_min = 0.6;
+
+static QStringList split_words(const QString &text);
+static QSet<QString> word_trigrams(const QString &word);
+
+void SearchIndex::add(const Release *release) {
+    const QString name_text = release->displayName() + " " + release->name();
+    const QString text = release->summary() + " " + release->description();
+
+    addTrigrams(release, name_text, Field_NAME);
+    addTrigrams(release, text, Field_TEXT);
+
+    documents[release] = (name_text + " " + text).toCaseFolded();
+
+    updateVariants(release);
+}
+
+void SearchIndex::remove(const Release *release) {
+    removeTrigrams(release, releaseTrigrams.value(release), Field_NAME | Field_TEXT | Field_VARIANTS);
+
+    releaseTrigrams.remove(release);
+    variantTrigrams.remove(release);
+    documents.remove(release);
+    variantDocuments.remove(release);
+}
+
+void SearchIndex::updateVariants(const Release *release) {
+    removeTrigrams(release, variantTrigrams.value(release), Field_VARIANTS);
+
+    const QString text = [release]() {
+        QStringList out;
+
+        for (const Variant *variant : release->variantList()) {
+            const QString variant_name = variant->name();
+
+            if (!out.contains(variant_name)) {
+                out.append(variant_name);
+            }
+        }
+
+        return out.join(" ");
+    }();
+
+    variantTrigrams[release] = addTrigrams(release, text, Field_VARIANTS);
+    variantDocuments[release] = text.toCaseFolded();
+}
+
+QHash<const Release *, qreal> SearchIndex::search(const QString &query) const {
+    const QStringList words = split_words(query.toCaseFolded());
+
+    QHash<const Release *, qreal> out;
+
+    for (int i = 0; i < words.size(); i++) {
+        const QString word = words[i];
+        const QSet<QString> trigrams = word_trigrams(word);
+
+        const QHash<const Release *, qreal> word_ranks = [&]() {
+            QHash<const Release *, qreal> ranks;
+
+            // Too short for trigrams, so look for
+            // substrings
+            if (trigrams.isEmpty()) {
+                for (auto it = documents.begin(); it != documents.end(); it++) {
+                    const Release *release = it.key();
+                    const bool match = (it.value().contains(word) || variantDocuments.value(release).contains(word));
+
+                    if (match) {
+                        ranks[release] = 1.0;
+                    }
+                }
+
+                return ranks;
+            }
+
+            QHash<const Release *, int> matched;
+            QHash<const Release *, int> matched_name;
+
+            for (const QString &trigram : trigrams) {
+                const QHash<const Release *, int> posting = postings.value(trigram);
+
+                for (auto it = posting.begin(); it != posting.end(); it++) {
+                    matched[it.key()]++;
+
+                    if (it.value() & Field_NAME) {
+                        matched_name[it.key()]++;
+                    }
+                }
+            }
+
+            for (auto it = matched.begin(); it != matched.end(); it++) {
+                const qreal ratio = (qreal) it.value() / trigrams.size();
+
+                if (ratio >= match_ratio_min) {
+                    const qreal name_ratio = (qreal) matched_name.value(it.key()) / trigrams.size();
+
+                    ranks[it.key()] = ratio + name_ratio;
+                }
+            }
+
+            return ranks;
+        }();
+
+        // Releases have to match all words
+        if (i == 0) {
+            out = word_ranks;
+        } else {
+            for (auto it = out.begin(); it != out.end();) {
+                if (word_ranks.contains(it.key())) {
+                    it.value() += word_ranks[it.key()];
+                    it++;
+                } else {
+                    it = out.erase(it);
+                }
+            }
+        }
+
+        if (out.isEmpty()) {
+            break;
+        }
+    }
+
+    return out;
+}
+
+QSet<QString> SearchIndex::addTrigrams(const Release *release, const QString &text, const Field field) {
+    QSet<QString> out;
+
+    for (const QString &word : split_words(text.toCaseFolded())) {
+        out.unite(word_trigrams(word));
+    }
+
+    for (const QString &trigram : out) {
+        postings[trigram][release] |= field;
+    }
+
+    releaseTrigrams[release].unite(out);
+
+    return out;
+}
+
+void SearchIndex::removeTrigrams(const Release *release, const QSet<QString> &trigrams, const int fields) {
+    for (const QString &trigram : trigrams) {
+        if (!postings.contains(trigram)) {
+            continue;
+        }
+
+        QHash<const Release *, int> &posting = postings[trigram];
+
+        const int fields_left = (posting.value(release) & ~fields);
+
+        if (fields_left != 0) {
+            posting[release] = fields_left;
+        } else {
+            posting.remove(release);
+            releaseTrigrams[release].remove(trigram);
+        }
+
+        if (posting.isEmpty()) {
+            postings.remove(trigram);
+        }
+    }
+}
+
+QStringList split_words(const QString &text) {
+    return text.split(QRegExp("\\W+"), QString::SkipEmptyParts);
+}
+
+// NOTE: words are padded at the start, so that
+// beginnings of words match better and two letter
+// words have a trigram
+QSet<QString> word_trigrams(const QString &word) {
+    QSet<QString> out;
+
+    const QString padded = " " + word;
+
+    for (int i = 0; i + 3 <= padded.size(); i++) {
+        out.insert(padded.mid(i, 3));
+    }
+
+    return out;
+}
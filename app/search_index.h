@@ -0,0 +1,78 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef SEARCH_INDEX_H
+#define SEARCH_INDEX_H
+
+/*
+ * SearchIndex is a trigram index over release names,
+ * summaries, descriptions and the architectures and boards
+ * of their variants. Query words are matched by how many
+ * of their trigrams a release contains, so that typos and
+ * partial words still match. Words that are too short to
+ * have trigrams are matched as substrings. Releases match
+ * if they match every word of the query and are ranked by
+ * how well they match, with matches in names ranked higher.
+ * The index is updated one release at a time, so it
+ * follows the catalog as it changes.
+ */
+
+#include <QHash>
+#include <QSet>
+#include <QString>
+
+class Release;
+
+class SearchIndex {
+public:
+    void add(const Release *release);
+    void remove(const Release *release);
+    // Updates the part of the index that comes from
+    // release's variants
+    void updateVariants(const Release *release);
+
+    // Returns matching releases and their ranks, higher
+    // rank is a better match. Empty query matches
+    // nothing, callers should handle that themselves.
+    QHash<const Release *, qreal> search(const QString &query) const;
+
+private:
+    enum Field {
+        Field_NAME = 1 << 0,
+        Field_TEXT = 1 << 1,
+        Field_VARIANTS = 1 << 2,
+    };
+
+    // Trigram => release => fields that contain it
+    QHash<QString, QHash<const Release *, int>> postings;
+    QHash<const Release *, QSet<QString>> releaseTrigrams;
+    QHash<const Release *, QSet<QString>> variantTrigrams;
+    // Case folded text of fields, for short words
+    QHash<const Release *, QString> documents;
+    QHash<const Release *, QString> variantDocuments;
+
+    QSet<QString> addTrigrams(const Release *release, const QString &text, const Field field);
+    void removeTrigrams(const Release *release, const QSet<QString> &trigrams, const int fields);
+};
+
+#endif // SEARCH_INDEX_H
@@ -0,0 +1,119 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include "settings.h"
+
+#include <QSettings>
+
+bool settings_direct_write() {
+    const QSettings settings;
+
+    return settings.value("directWrite", false).toBool();
+}
+
+// NOTE: stored as an array, for example:
+// [mirrors]
+// 1\url=http://ftp.altlinux.org/pub/distributions/ALTLinux
+// 1\path=/mnt/mirror/ALTLinux
+// size=1
+QHash<QString, QString> settings_mirror_paths() {
+    QSettings settings;
+    QHash<QString, QString> out;
+
+    const int size = settings.beginReadArray("mirrors");
+    for (int i = 0; i < size; i++) {
+        settings.setArrayIndex(i);
+
+        const QString url = settings.value("url").toString();
+        const QString path = settings.value("path").toString();
+
+        if (!url.isEmpty() && !path.isEmpty()) {
+            out[url] = path;
+        }
+    }
+    settings.endArray();
+
+    return out;
+}
+
+bool settings_peer_cache_serve() {
+    const QSettings settings;
+
+    return settings.value("peerCache/serve", false).toBool();
+}
+
+quint16 settings_peer_cache_port() {
+    const QSettings settings;
+
+    return settings.value("peerCache/port", 8735).toUInt();
+}
+
+QString settings_peer_cache_address() {
+    const QSettings settings;
+
+    return settings.value("peerCache/address").toString();
+}
+
+QStringList settings_peer_cache_peers() {
+    const QSettings settings;
+
+    return settings.value("peerCache/peers").toStringList();
+}
+
+bool settings_prefetch() {
+    const QSettings settings;
+
+    return settings.value("prefetch", false).toBool();
+}
+
+QStringList settings_download_dirs() {
+    const QSettings settings;
+
+    return settings.value("downloadDirs").toStringList();
+}
+
+QString settings_metadata_host() {
+    const QSettings settings;
+
+    return settings.value("metadataHost").toString();
+}
+
+// NOTE: stored in minutes
+int settings_metadata_refresh_interval() {
+    const QSettings settings;
+
+    return settings.value("metadataRefreshInterval", 60).toInt() * 60 * 1000;
+}
+
+// NOTE: stored in gigabytes
+qint64 settings_decompressed_cache_size() {
+    const QSettings settings;
+
+    return settings.value("decompressedCacheSize", 0).toLongLong() * 1024L * 1024L * 1024L;
+}
+
+QString settings_trace_file() {
+    const QSettings settings;
+
+    return settings.value("traceFile").toString();
+}
@@ -0,0 +1,86 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+/*
+ * Settings for setups that need to tweak the default
+ * behavior. These are not exposed in the UI, instead
+ * they are read from the config file managed by
+ * QSettings, which on linux is
+ * ~/.config/BaseALT/ALTMediaWriter.conf
+ */
+
+// If true, downloaded images are written directly to
+// the selected drive without saving them to disk
+bool settings_direct_write();
+
+// Maps url prefixes of mirrors to local directories
+// where those mirrors are mounted (over NFS, SMB, etc).
+// Images under a mapped prefix are written directly from
+// the local directory instead of being downloaded.
+QHash<QString, QString> settings_mirror_paths();
+
+// If true, downloaded images are served to other
+// instances in the LAN on the peer cache port
+bool settings_peer_cache_serve();
+quint16 settings_peer_cache_port();
+
+// Address that the peer cache is served on. Empty if
+// not set, then the LAN address of this machine is used.
+QString settings_peer_cache_address();
+
+// Addresses of other instances that serve their images,
+// in the form of "host:port"
+QStringList settings_peer_cache_peers();
+
+// If true, images that the user is likely to pick are
+// downloaded in the background while network is idle
+bool settings_prefetch();
+
+// Additional directories where images can be downloaded,
+// the fastest one with enough space is used
+QStringList settings_download_dirs();
+
+// Host that metadata url lists are downloaded from,
+// instead of the default ones. Empty if not set.
+QString settings_metadata_host();
+
+// Interval in milliseconds between checks for new
+// metadata, 0 if metadata shouldn't be refreshed
+int settings_metadata_refresh_interval();
+
+// Size limit in bytes for decompressed copies of
+// compressed images, 0 if they shouldn't be kept
+qint64 settings_decompressed_cache_size();
+
+// File that startup and metadata loading traces are
+// saved to on quit. Empty if tracing is off.
+QString settings_trace_file();
+
+#endif // SETTINGS_H
@@ -0,0 +1,280 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include "throughput.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QSettings>
+#include <QThread>
+
+#include <lzma.h>
+
+// NOTE: short transfers are dominated by latency and
+// would make the estimates too pessimistic
+static const qint64 sample_bytes_min = 16L * 1024L * 1024L;
+static const qint64 sample_msecs_min = 1000;
+
+static QString drive_key(const QString &drive_name);
+static QString host_key(const QString &host);
+static qint64 get_speed(const QString &key);
+static void set_speed(const QString &key, const qint64 speed);
+static void record_speed(const QString &key, const qint64 bytes, const qint64 msecs);
+static void run_decompress_benchmark();
+
+qint64 throughput_download() {
+    return get_speed("download");
+}
+
+void throughput_record_download(const qint64 bytes, const qint64 msecs) {
+    record_speed("download", bytes, msecs);
+}
+
+qint64 throughput_write(const QString &drive_name) {
+    const qint64 drive_speed = get_speed(drive_key(drive_name));
+
+    if (drive_speed > 0) {
+        return drive_speed;
+    } else {
+        return get_speed("write");
+    }
+}
+
+void throughput_record_write(const QString &drive_name, const qint64 bytes, const qint64 msecs) {
+    record_speed(drive_key(drive_name), bytes, msecs);
+    record_speed("write", bytes, msecs);
+}
+
+qint64 throughput_decompress() {
+    return get_speed("decompress");
+}
+
+void throughput_benchmark_decompress() {
+    if (throughput_decompress() > 0) {
+        return;
+    }
+
+    auto thread = new QThread();
+    auto worker = new QObject();
+    worker->moveToThread(thread);
+
+    QObject::connect(
+        thread, &QThread::started,
+        worker, [thread]() {
+            run_decompress_benchmark();
+            thread->quit();
+        });
+    QObject::connect(
+        thread, &QThread::finished,
+        worker, &QObject::deleteLater);
+    QObject::connect(
+        thread, &QThread::finished,
+        thread, &QObject::deleteLater);
+
+    // NOTE: thread has to be stopped before the
+    // application object is destroyed. The benchmark
+    // is short, so just wait for it.
+    QObject::connect(
+        qApp, &QCoreApplication::aboutToQuit,
+        thread, [thread]() {
+            thread->quit();
+            thread->wait();
+        });
+
+    thread->start(QThread::LowestPriority);
+}
+
+int throughput_download_estimate(const qint64 bytes) {
+    const qint64 speed = throughput_download();
+
+    if (bytes <= 0 || speed <= 0) {
+        return -1;
+    }
+
+    return (int) (bytes / speed);
+}
+
+int throughput_total_estimate(const qint64 download_size, const qint64 image_size, const bool compressed, const QString &drive_name) {
+    const qint64 download_speed = throughput_download();
+    const qint64 write_speed = throughput_write(drive_name);
+    const qint64 decompress_speed = throughput_decompress();
+
+    if (download_size <= 0 || image_size <= 0 || download_speed <= 0) {
+        return -1;
+    }
+    if (compressed && decompress_speed <= 0) {
+        return -1;
+    }
+
+    const qint64 download_time = download_size / download_speed;
+
+    // NOTE: if write speed is unknown, assume that writing
+    // is not the bottleneck, it's the same for every
+    // format anyway. Decompression happens while writing,
+    // so the slower of the two is what counts.
+    const qint64 write_time = [&]() -> qint64 {
+        const qint64 plain_time = [&]() -> qint64 {
+            if (write_speed > 0) {
+                return image_size / write_speed;
+            } else {
+                return 0;
+            }
+        }();
+
+        if (compressed) {
+            return qMax(plain_time, image_size / decompress_speed);
+        } else {
+            return plain_time;
+        }
+    }();
+
+    return (int) (download_time + write_time);
+}
+
+// NOTE: latencies are stored the same way as speeds
+qint64 throughput_latency(const QString &host) {
+    return get_speed(host_key(host));
+}
+
+// Latencies are smoothed like speeds, but short
+// responses are what's being measured, so all samples
+// count
+void throughput_record_latency(const QString &host, const qint64 msecs) {
+    const QString key = host_key(host);
+    const qint64 sample = qMax(msecs, (qint64) 1);
+    const qint64 old_latency = get_speed(key);
+    const qint64 new_latency = [sample, old_latency]() {
+        if (old_latency > 0) {
+            return (old_latency + sample) / 2;
+        } else {
+            return sample;
+        }
+    }();
+
+    set_speed(key, new_latency);
+}
+
+// NOTE: slashes in keys are treated as groups by
+// QSettings
+QString drive_key(const QString &drive_name) {
+    QString name = drive_name;
+    name.replace('/', '_');
+
+    return "write/" + name;
+}
+
+QString host_key(const QString &host) {
+    QString name = host;
+    name.replace('/', '_');
+
+    return "latency/" + name;
+}
+
+qint64 get_speed(const QString &key) {
+    const QSettings settings;
+
+    return settings.value("throughput/" + key, 0).toLongLong();
+}
+
+void set_speed(const QString &key, const qint64 speed) {
+    QSettings settings;
+    settings.setValue("throughput/" + key, speed);
+}
+
+// Speeds are smoothed so that one unusually slow or
+// fast transfer doesn't throw off the estimates
+void record_speed(const QString &key, const qint64 bytes, const qint64 msecs) {
+    if (bytes < sample_bytes_min || msecs < sample_msecs_min) {
+        return;
+    }
+
+    const qint64 sample = bytes * 1000 / msecs;
+    const qint64 old_speed = get_speed(key);
+    const qint64 new_speed = [sample, old_speed]() {
+        if (old_speed > 0) {
+            return (old_speed + sample) / 2;
+        } else {
+            return sample;
+        }
+    }();
+
+    set_speed(key, new_speed);
+}
+
+// Decompresses a generated image that is made to look
+// like a real one: runs of zeroes, repetitive data and
+// data that doesn't compress well
+void run_decompress_benchmark() {
+    static const size_t image_size = 16 * 1024 * 1024;
+    static const size_t block_size = 4096;
+    static const qint64 benchmark_msecs_min = 500;
+
+    QByteArray image(image_size, 0);
+    quint32 random_state = 1;
+    for (size_t block = 0; block < image_size / block_size; block++) {
+        char *block_data = image.data() + block * block_size;
+
+        for (size_t i = 0; i < block_size; i++) {
+            random_state = random_state * 1103515245 + 12345;
+
+            switch (block % 4) {
+                case 0: block_data[i] = 0; break;
+                case 1: block_data[i] = (char) (random_state >> 16); break;
+                default: block_data[i] = (char) ('a' + (i % 16) + ((random_state >> 28) == 0)); break;
+            }
+        }
+    }
+
+    QByteArray compressed(lzma_stream_buffer_bound(image_size), 0);
+    size_t compressed_size = 0;
+    const lzma_ret encode_ret = lzma_easy_buffer_encode(1, LZMA_CHECK_CRC64, nullptr, (const uint8_t *) image.constData(), image_size, (uint8_t *) compressed.data(), &compressed_size, compressed.size());
+    if (encode_ret != LZMA_OK) {
+        qDebug() << "Decompression benchmark failed to compress, error" << encode_ret;
+
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    qint64 decompressed_total = 0;
+
+    while (timer.elapsed() < benchmark_msecs_min) {
+        uint64_t memlimit = UINT64_MAX;
+        size_t in_pos = 0;
+        size_t out_pos = 0;
+        const lzma_ret decode_ret = lzma_stream_buffer_decode(&memlimit, 0, nullptr, (const uint8_t *) compressed.constData(), &in_pos, compressed_size, (uint8_t *) image.data(), &out_pos, image_size);
+        if (decode_ret != LZMA_OK) {
+            qDebug() << "Decompression benchmark failed to decompress, error" << decode_ret;
+
+            return;
+        }
+
+        decompressed_total += out_pos;
+    }
+
+    const qint64 speed = decompressed_total * 1000 / timer.elapsed();
+    qDebug() << "Decompression speed is" << speed << "bytes per second";
+
+    set_speed("decompress", speed);
+}
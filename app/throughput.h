@@ -0,0 +1,69 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef THROUGHPUT_H
+#define THROUGHPUT_H
+
+/*
+ * Throughput measurements that are used to estimate how
+ * long operations will take. Measurements are saved
+ * between sessions, so estimates are available before
+ * anything is done in the current session. All speeds
+ * are in bytes per second and are 0 if nothing was
+ * measured yet.
+ */
+
+#include <QString>
+
+qint64 throughput_download();
+void throughput_record_download(const qint64 bytes, const qint64 msecs);
+
+// Write speed of the drive with this name, or of any
+// drive if this one wasn't written to yet
+qint64 throughput_write(const QString &drive_name);
+void throughput_record_write(const QString &drive_name, const qint64 bytes, const qint64 msecs);
+
+// Speed of xz decompression on this machine, in bytes of
+// decompressed data per second
+qint64 throughput_decompress();
+
+// Measures decompression speed on a separate thread, if
+// it wasn't measured before
+void throughput_benchmark_decompress();
+
+// Returns how many seconds it would take to download
+// this many bytes, or -1 if it can't be estimated
+int throughput_download_estimate(const qint64 bytes);
+
+// Returns how many seconds it would take to download an
+// image and write it to the drive, or -1 if it can't be
+// estimated. For compressed images, image_size is the
+// size after decompression.
+int throughput_total_estimate(const qint64 download_size, const qint64 image_size, const bool compressed, const QString &drive_name);
+
+// Time in milliseconds that it took to get a response
+// from this host, or 0 if the host wasn't contacted yet
+qint64 throughput_latency(const QString &host);
+void throughput_record_latency(const QString &host, const qint64 msecs);
+
+#endif // THROUGHPUT_H
@@ -0,0 +1,252 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include "trace.h"
+#include "settings.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+
+enum TraceEventType {
+    TraceEventType_SPAN,
+    TraceEventType_ASYNC_SPAN,
+    TraceEventType_MEMORY,
+};
+
+struct TraceEvent {
+    TraceEventType type;
+    QString name;
+    QString category;
+    qint64 start_time;
+    qint64 duration;
+    int thread_id;
+    QJsonObject args;
+};
+
+// NOTE: metadata is refreshed periodically, so events
+// are capped to not grow forever in long sessions
+const int TRACE_EVENTS_MAX = 100000;
+
+static bool trace_enabled = false;
+static bool trace_save_connected = false;
+static QElapsedTimer trace_timer;
+static QMutex trace_mutex;
+static QList<TraceEvent> trace_events;
+static QHash<QThread *, int> trace_thread_ids;
+
+static void trace_record(const TraceEventType type, const QString &name, const QString &category, const qint64 start_time, const QJsonObject &args);
+static qint64 resident_memory();
+static void trace_save();
+
+void trace_init() {
+    const QString path = settings_trace_file();
+
+    trace_enabled = !path.isEmpty();
+
+    if (!trace_enabled) {
+        return;
+    }
+
+    qDebug() << "Tracing to" << path;
+
+    trace_timer.start();
+}
+
+qint64 trace_now() {
+    if (!trace_enabled) {
+        return 0;
+    }
+
+    return trace_timer.nsecsElapsed() / 1000;
+}
+
+void trace_span(const QString &name, const QString &category, const qint64 start_time, const QJsonObject &args) {
+    trace_record(TraceEventType_SPAN, name, category, start_time, args);
+}
+
+void trace_async_span(const QString &name, const QString &category, const qint64 start_time, const QJsonObject &args) {
+    trace_record(TraceEventType_ASYNC_SPAN, name, category, start_time, args);
+}
+
+void trace_memory() {
+    if (!trace_enabled) {
+        return;
+    }
+
+    const qint64 memory = resident_memory();
+    if (memory == 0) {
+        return;
+    }
+
+    const QJsonObject args = {
+        {"resident_kb", memory},
+    };
+    trace_record(TraceEventType_MEMORY, "Memory", "memory", trace_now(), args);
+}
+
+void trace_record(const TraceEventType type, const QString &name, const QString &category, const qint64 start_time, const QJsonObject &args) {
+    if (!trace_enabled) {
+        return;
+    }
+
+    const qint64 end_time = trace_now();
+
+    QMutexLocker locker(&trace_mutex);
+
+    if (trace_events.size() >= TRACE_EVENTS_MAX) {
+        return;
+    }
+
+    // NOTE: saving on quit is set up once the app
+    // exists, which might be after the first spans
+    if (!trace_save_connected && qApp != nullptr) {
+        QObject::connect(
+            qApp, &QCoreApplication::aboutToQuit,
+            trace_save);
+        trace_save_connected = true;
+    }
+
+    // Threads are numbered in the order that they
+    // recorded their first span, main thread is usually
+    // the first
+    QThread *thread = QThread::currentThread();
+    if (!trace_thread_ids.contains(thread)) {
+        const int new_id = trace_thread_ids.size() + 1;
+        trace_thread_ids[thread] = new_id;
+    }
+
+    TraceEvent event;
+    event.type = type;
+    event.name = name;
+    event.category = category;
+    event.start_time = start_time;
+    event.duration = end_time - start_time;
+    event.thread_id = trace_thread_ids[thread];
+    event.args = args;
+
+    trace_events.append(event);
+}
+
+// NOTE: spans are saved as "complete" events, async
+// spans as pairs of "begin" and "end" events and memory
+// as "counter" events, see Trace Event Format document
+// for details
+void trace_save() {
+    const QString path = settings_trace_file();
+
+    QMutexLocker locker(&trace_mutex);
+
+    QJsonArray event_array;
+
+    for (int i = 0; i < trace_events.size(); i++) {
+        const TraceEvent &event = trace_events[i];
+
+        QJsonObject object;
+        object["name"] = event.name;
+        object["cat"] = event.category;
+        object["pid"] = 1;
+        object["tid"] = event.thread_id;
+
+        if (!event.args.isEmpty()) {
+            object["args"] = event.args;
+        }
+
+        if (event.type == TraceEventType_ASYNC_SPAN) {
+            object["id"] = i;
+
+            QJsonObject begin = object;
+            begin["ph"] = "b";
+            begin["ts"] = event.start_time;
+            event_array.append(begin);
+
+            QJsonObject end = object;
+            end["ph"] = "e";
+            end["ts"] = event.start_time + event.duration;
+            event_array.append(end);
+        } else if (event.type == TraceEventType_MEMORY) {
+            object["ph"] = "C";
+            object["ts"] = event.start_time;
+            event_array.append(object);
+        } else {
+            object["ph"] = "X";
+            object["ts"] = event.start_time;
+            object["dur"] = event.duration;
+            event_array.append(object);
+        }
+    }
+
+    QJsonObject root;
+    root["traceEvents"] = event_array;
+    root["displayTimeUnit"] = "ms";
+
+    QFile file(path);
+
+    const bool open_success = file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    if (!open_success) {
+        qDebug() << "Failed to save trace to" << path;
+
+        return;
+    }
+
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+
+    qDebug() << "Saved" << trace_events.size() << "trace events to" << path;
+}
+
+// Returns resident memory of the app in kilobytes, 0 if
+// it can't be found out on this platform
+qint64 resident_memory() {
+#ifdef __linux
+    QFile file("/proc/self/status");
+
+    const bool open_success = file.open(QIODevice::ReadOnly);
+    if (!open_success) {
+        return 0;
+    }
+
+    // Line is of the form "VmRSS:    1234 kB"
+    const QList<QByteArray> lines = file.readAll().split('\n');
+    for (const QByteArray &line : lines) {
+        if (line.startsWith("VmRSS:")) {
+            const QList<QByteArray> elements = line.simplified().split(' ');
+
+            if (elements.size() >= 2) {
+                return elements[1].toLongLong();
+            }
+        }
+    }
+
+    return 0;
+#else
+    return 0;
+#endif
+}
@@ -0,0 +1,61 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef TRACE_H
+#define TRACE_H
+
+/*
+ * Tracing of startup and metadata loading. Spans of work
+ * are recorded with their start time and duration and
+ * are saved on quit in Chrome's trace event format, so
+ * the file can be opened in chrome://tracing or
+ * Perfetto to see where the time went. Tracing is off
+ * unless trace file is set in settings, then recording
+ * a span costs nothing.
+ */
+
+#include <QJsonObject>
+#include <QString>
+
+// Must be called at the very start of the app, before
+// any spans are recorded
+void trace_init();
+
+// Time in microseconds since trace_init(), 0 if tracing
+// is off
+qint64 trace_now();
+
+// Records a span that started at start_time and ends
+// now. Can be called from any thread.
+void trace_span(const QString &name, const QString &category, const qint64 start_time, const QJsonObject &args = QJsonObject());
+
+// Same as above for work that overlaps with other work
+// on the same thread, like network requests. These are
+// shown on their own tracks.
+void trace_async_span(const QString &name, const QString &category, const qint64 start_time, const QJsonObject &args = QJsonObject());
+
+// Records how much memory the app uses at this point,
+// only supported on Linux
+void trace_memory();
+
+#endif // TRACE_H
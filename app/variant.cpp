@@ -22,29 +22,58 @@
 
 #include "variant.h"
 #include "architecture.h"
+#include "download_location.h"
 #include "drivemanager.h"
 #include "image_download.h"
+#include "image_files.h"
+#include "image_probe.h"
+#include "md5sum_fetcher.h"
 #include "network.h"
+#include "peer_cache.h"
+#include "prefetch.h"
 #include "progress.h"
 #include "release.h"
 #include "releasemanager.h"
+#include "settings.h"
+#include "throughput.h"
 
 #include <QDir>
 #include <QFileInfo>
-#include <QStandardPaths>
 
-Variant::Variant(const QString &url, const Architecture arch, const FileType fileType, const QString &board, const bool live, const QString &md5sum, QObject *parent)
+QString mirror_path_for_url(const QString &url, const QHash<QString, QString> &mirror_paths);
+
+Variant::Variant(const QString &url, const QHash<QString, QString> &mirror_paths, const Architecture arch, const FileType fileType, const QString &board, const bool live, QObject *parent)
 : QObject(parent) {
     m_url = url;
     m_fileName = QUrl(url).fileName();
-    m_filePath = QDir(QStandardPaths::writableLocation(QStandardPaths::DownloadLocation)).filePath(fileName());
+    // NOTE: the real location is picked when download
+    // starts, when the size is known
+    m_filePath = download_location_find_file(fileName());
+    m_mirrorPath = mirror_path_for_url(url, mirror_paths);
     m_board = board;
     m_live = live;
-    m_md5sum = md5sum;
+    m_md5sum = QString();
+    m_md5sumFetched = false;
+    downloadPending = false;
+    writePending = false;
     m_arch = arch;
     m_fileType = fileType;
     m_status = Variant::PREPARING;
+    delayedWrite = false;
+    m_size = 0;
+    m_volumeSize = 0;
+    m_lastModified = QDateTime();
+    m_probed = false;
+    m_estimate = -1;
+    m_recommended = false;
     m_progress = new Progress(this);
+
+    connect(
+        ImageFiles::instance(), &ImageFiles::filesChanged,
+        this, &Variant::onImageFilesChanged);
+    connect(
+        Md5sumFetcher::instance(), &Md5sumFetcher::cleared,
+        this, &Variant::resetMd5sum);
 }
 
 Variant::Variant(const QString &path, QObject *parent)
@@ -52,15 +81,50 @@ Variant::Variant(const QString &path, QObject *parent)
     m_url = QString();
     m_fileName = QFileInfo(path).fileName();
     m_filePath = path;
+    m_mirrorPath = QString();
     m_board = QString();
     m_live = false;
     m_md5sum = QString();
+    m_md5sumFetched = true;
+    downloadPending = false;
+    writePending = false;
     m_arch = Architecture_UNKNOWN;
     m_fileType = file_type_from_filename(path);
     m_status = Variant::READY_FOR_WRITING;
+    delayedWrite = false;
+    m_size = QFileInfo(path).size();
+    m_volumeSize = 0;
+    m_lastModified = QDateTime();
+    m_probed = true;
+    m_estimate = -1;
+    m_recommended = false;
     m_progress = new Progress(this);
 }
 
+void Variant::update(const Architecture arch, const FileType fileType, const QString &board, const bool live) {
+    const bool changed = (m_arch != arch || m_fileType != fileType || m_board != board || m_live != live);
+    if (!changed) {
+        return;
+    }
+
+    m_arch = arch;
+    m_fileType = fileType;
+    m_board = board;
+    m_live = live;
+    emit detailsChanged();
+
+    // NOTE: download or write in progress already uses
+    // the old md5sum and size
+    if (!isBusy()) {
+        resetMd5sum();
+
+        m_probed = false;
+        m_volumeSize = 0;
+        m_lastModified = QDateTime();
+        setSize(0);
+    }
+}
+
 Architecture Variant::arch() const {
     return m_arch;
 }
@@ -77,6 +141,71 @@ QString Variant::md5sum() const {
     return m_md5sum;
 }
 
+bool Variant::md5sumFetched() const {
+    return m_md5sumFetched;
+}
+
+void Variant::fetchMd5sum() {
+    if (!m_md5sumFetched) {
+        Md5sumFetcher::instance()->fetch(this);
+    }
+}
+
+void Variant::setMd5sum(const QString &md5sum) {
+    m_md5sum = md5sum;
+    m_md5sumFetched = true;
+    emit md5sumChanged();
+
+    if (downloadPending) {
+        downloadPending = false;
+        continueDownload();
+    } else if (m_status == PREPARING && ImageFiles::instance()->exists(filePath())) {
+        // Downloaded image can be written now
+        resetStatus();
+    }
+
+    if (writePending) {
+        writePending = false;
+        setDelayedWrite(delayedWrite);
+    }
+}
+
+// NOTE: images are downloaded and written only with a
+// known md5sum, so that they can be checked. Images
+// that have no md5sum at all are a different case, for
+// them the MD5SUM file is missing and md5sum is empty.
+void Variant::setMd5sumFailed() {
+    emit md5sumFailed();
+
+    if (downloadPending || writePending) {
+        downloadPending = false;
+        writePending = false;
+        delayedWrite = false;
+
+        setErrorString(tr("Failed to download the checksum of the image. Check your connection and try again."));
+        setStatus(DOWNLOAD_FAILED);
+    }
+}
+
+// NOTE: md5sum of a local file is never fetched.
+// Download or write in progress already uses the old
+// md5sum.
+void Variant::resetMd5sum() {
+    if (m_url.isEmpty() || !m_md5sumFetched || isBusy()) {
+        return;
+    }
+
+    m_md5sum = QString();
+    m_md5sumFetched = false;
+    emit md5sumChanged();
+
+    // Downloaded image can't be written until md5sum is
+    // fetched again
+    if (m_status == READY_FOR_WRITING) {
+        resetStatus();
+    }
+}
+
 QString Variant::name() const {
     QString out = architecture_name(m_arch) + " | " + m_board;
 
@@ -87,6 +216,14 @@ QString Variant::name() const {
     return out;
 }
 
+QString Variant::board() const {
+    return m_board;
+}
+
+bool Variant::live() const {
+    return m_live;
+}
+
 QString Variant::url() const {
     return m_url;
 }
@@ -100,24 +237,81 @@ bool Variant::canWrite() const {
 }
 
 bool Variant::noMd5sum() const {
-    return md5sum().isEmpty();
+    return m_md5sumFetched && md5sum().isEmpty();
 }
 
 bool Variant::isCompressed() const {
     return (m_fileType == FileType_TAR_XZ || m_fileType == FileType_IMG_XZ);
 }
 
+qint64 Variant::size() const {
+    return m_size;
+}
+
+int Variant::downloadEstimate() const {
+    return throughput_download_estimate(m_size);
+}
+
+int Variant::estimate() const {
+    return m_estimate;
+}
+
+bool Variant::recommended() const {
+    return m_recommended;
+}
+
+void Variant::setEstimate(const int estimate, const bool recommended) {
+    if (m_estimate != estimate || m_recommended != recommended) {
+        m_estimate = estimate;
+        m_recommended = recommended;
+        emit estimateChanged();
+    }
+}
+
+bool Variant::isEquivalent(const Variant *other) const {
+    return (m_arch == other->m_arch && m_board == other->m_board && m_live == other->m_live);
+}
+
+void Variant::setFilePath(const QString &path) {
+    if (m_filePath != path) {
+        m_filePath = path;
+        emit fileChanged();
+    }
+}
+
+void Variant::setSize(const qint64 size) {
+    if (m_size != size) {
+        m_size = size;
+        emit sizeChanged();
+    }
+}
+
 Progress *Variant::progress() {
     return m_progress;
 }
 
 void Variant::setDelayedWrite(const bool value) {
+    // NOTE: streamed images are already being written
+    if (streamDrive != nullptr) {
+        return;
+    }
+
     delayedWrite = value;
 
+    // NOTE: writing starts once md5sum is fetched
+    if (value && !m_md5sumFetched) {
+        writePending = true;
+        fetchMd5sum();
+
+        return;
+    }
+    writePending = false;
+
     Drive *drive = DriveManager::instance()->selected();
     if (drive != nullptr) {
         if (value) {
             drive->write(this);
+            emit delayedWriteStarted();
         } else {
             drive->cancel();
         }
@@ -128,9 +322,22 @@ Variant::Status Variant::status() const {
     if (m_status == READY_FOR_WRITING && DriveManager::instance()->isBackendBroken()) {
         return WRITING_NOT_POSSIBLE;
     }
+
     return m_status;
 }
 
+bool Variant::isBusy() const {
+    static const QList<Status> busy_statuses = {
+        DOWNLOADING,
+        DOWNLOAD_RESUMING,
+        DOWNLOAD_VERIFYING,
+        WRITING,
+        WRITE_VERIFYING,
+    };
+
+    return busy_statuses.contains(m_status);
+}
+
 QString Variant::statusString() const {
     if (m_statusStrings.contains(status())) {
         return m_statusStrings[status()];
@@ -143,6 +350,52 @@ void Variant::onImageDownloadFinished() {
     ImageDownload *download = qobject_cast<ImageDownload *>(sender());
     const ImageDownload::Result result = download->result();
 
+    if (streamDrive != nullptr) {
+        // NOTE: when streaming, writing status is
+        // reported by the drive. Download only needs to
+        // let the drive know that the image has ended or
+        // stop the write if download failed.
+        Drive *drive = streamDrive;
+        streamDrive = nullptr;
+
+        switch (result) {
+            case ImageDownload::Success: {
+                drive->finishStream();
+
+                break;
+            }
+            case ImageDownload::Md5CheckFail: {
+                qDebug() << "MD5 check of" << m_url << "failed";
+                drive->cancel();
+                setErrorString(tr("The downloaded image is corrupted"));
+                setStatus(WRITING_FAILED);
+
+                break;
+            }
+            case ImageDownload::DiskError:
+            case ImageDownload::NetworkError: {
+                drive->cancel();
+                setErrorString(download->errorString());
+                setStatus(WRITING_FAILED);
+
+                break;
+            }
+            case ImageDownload::Cancelled: {
+                drive->cancel();
+
+                // Cancelled because of an error, like the
+                // image not fitting on the drive
+                if (!errorString().isEmpty()) {
+                    setStatus(WRITING_FAILED);
+                }
+
+                break;
+            }
+        }
+
+        return;
+    }
+
     switch (result) {
         case ImageDownload::Success: {
             qDebug() << this->metaObject()->className() << "Image is ready";
@@ -150,7 +403,8 @@ void Variant::onImageDownloadFinished() {
 
             break;
         }
-        case ImageDownload::DiskError: {
+        case ImageDownload::DiskError:
+        case ImageDownload::NetworkError: {
             setErrorString(download->errorString());
             setStatus(DOWNLOAD_FAILED);
 
@@ -171,74 +425,180 @@ void Variant::onImageDownloadFinished() {
 
 void Variant::download() {
     delayedWrite = false;
+    writePending = false;
+    streamDrive = nullptr;
 
     resetStatus();
 
-    const bool already_downloaded = QFile::exists(filePath());
+    // NOTE: md5sum is needed to check the download and
+    // the written image, continue once it's fetched
+    if (!m_md5sumFetched) {
+        downloadPending = true;
+        fetchMd5sum();
+
+        return;
+    }
+
+    continueDownload();
+}
+
+void Variant::continueDownload() {
+    // NOTE: pick download location again, now that the
+    // size of the image might be known
+    const bool from_mirror = useMirror();
+    if (!from_mirror) {
+        setFilePath(download_location_for_file(fileName(), size()));
+    }
+
+    // NOTE: checked on disk if download directories
+    // weren't listed yet, so that an image isn't
+    // downloaded twice
+    const bool file_exists = [this]() {
+        if (ImageFiles::instance()->scanned()) {
+            return ImageFiles::instance()->exists(filePath());
+        } else {
+            return QFile::exists(filePath());
+        }
+    }();
+    const bool already_downloaded = (from_mirror || file_exists);
 
     if (already_downloaded) {
         // Already downloaded so skip download step
         qDebug() << this->metaObject()->className() << fileName() << "is already downloaded";
         setStatus(READY_FOR_WRITING);
+    } else {
+        startDownload();
+    }
+}
+
+void Variant::startDownload() {
+    Drive *drive = DriveManager::instance()->selected();
+    const bool direct_write = (settings_direct_write() && drive != nullptr && canWrite());
+
+    if (direct_write) {
+        streamToDrive(drive);
     } else {
         // Download image
-        auto download = new ImageDownload(QUrl(url()), filePath(), md5sum());
+        Prefetcher::instance()->userDownloadStarted();
+        auto download = new ImageDownload(QUrl(url()), filePath(), md5sum(), peer_cache_urls(fileName()));
+
+        connectImageDownload(download);
+    }
+}
+
+void Variant::streamToDrive(Drive *drive) {
+    QIODevice *sink = drive->writeStream(this);
+
+    if (sink == nullptr) {
+        setStatus(WRITING_FAILED);
+
+        return;
+    }
+
+    streamDrive = drive;
 
-        connect(
-            download, &ImageDownload::started,
-            [this]() {
-                setErrorString(QString());
+    Prefetcher::instance()->userDownloadStarted();
+    auto download = new ImageDownload(QUrl(url()), sink, md5sum(), peer_cache_urls(fileName()));
+
+    connectImageDownload(download);
+}
+
+void Variant::connectImageDownload(ImageDownload *download) {
+    connect(
+        download, &ImageDownload::started,
+        [this]() {
+            setErrorString(QString());
+
+            if (streamDrive != nullptr) {
+                setStatus(WRITING);
+            } else {
                 setStatus(DOWNLOADING);
-            });
-        connect(
-            download, &ImageDownload::interrupted,
-            [this]() {
-                setErrorString(tr("Connection was interrupted, attempting to resume"));
-                setStatus(DOWNLOAD_RESUMING);
-            });
-        connect(
-            download, &ImageDownload::startedMd5Check,
-            [this]() {
-                setErrorString(QString());
-                setStatus(DOWNLOAD_VERIFYING);
-            });
-        connect(
-            download, &ImageDownload::finished,
-            this, &Variant::onImageDownloadFinished);
-        connect(
-            download, &ImageDownload::progress,
-            [this](const qint64 value) {
-                m_progress->setCurrent(value);
-            });
-        connect(
-            download, &ImageDownload::progressMaxChanged,
-            [this](const qint64 value) {
-                m_progress->setMax(value);
-            });
-
-        connect(
-            this, &Variant::cancelledDownload,
-            download, &ImageDownload::cancel);
+            }
+        });
+    connect(
+        download, &ImageDownload::interrupted,
+        [this]() {
+            setErrorString(tr("Connection was interrupted, attempting to resume"));
+            setStatus(DOWNLOAD_RESUMING);
+        });
+    connect(
+        download, &ImageDownload::startedMd5Check,
+        [this]() {
+            setErrorString(QString());
+            setStatus(DOWNLOAD_VERIFYING);
+        });
+    connect(
+        download, &ImageDownload::finished,
+        this, &Variant::onImageDownloadFinished);
+    connect(
+        download, &ImageDownload::finished,
+        Prefetcher::instance(), &Prefetcher::userDownloadFinished);
+    connect(
+        download, &ImageDownload::progress,
+        [this](const qint64 value) {
+            m_progress->setCurrent(value);
+        });
+    connect(
+        download, &ImageDownload::progressMaxChanged,
+        [this](const qint64 value) {
+            setSize(value);
+            m_progress->setMax(value);
+
+            // NOTE: streamed image size is only known
+            // once download starts, so check that it fits
+            // here instead of when the write starts
+            if (streamDrive != nullptr && m_size > streamDrive->size()) {
+                setErrorString(tr("This drive is not large enough."));
+                emit cancelledDownload();
+            }
+        });
+
+    connect(
+        this, &Variant::cancelledDownload,
+        download, &ImageDownload::cancel);
+
+    // NOTE: a delayed write reads the partial file while
+    // it grows, so the download can't start over if peer
+    // data turns out to be broken
+    if (delayedWrite) {
+        download->setFileFollowed();
     }
+    connect(
+        this, &Variant::delayedWriteStarted,
+        download, &ImageDownload::setFileFollowed);
 }
 
 void Variant::cancelDownload() {
+    downloadPending = false;
     emit cancelledDownload();
 }
 
+// NOTE: downloaded image is ready for writing only once
+// its md5sum is known
 void Variant::resetStatus() {
-    if (QFile::exists(filePath())) {
+    const bool downloaded = ImageFiles::instance()->exists(filePath());
+
+    if (downloaded && m_md5sumFetched) {
         setStatus(READY_FOR_WRITING);
     } else {
         setStatus(PREPARING);
         m_progress->setMax(0.0);
         m_progress->setCurrent(0.0);
+
+        if (downloaded) {
+            fetchMd5sum();
+        }
     }
     setErrorString(QString());
     emit statusChanged();
 }
 
 bool Variant::erase() {
+    // Don't touch images on mirrors
+    if (filePath() == m_mirrorPath) {
+        return false;
+    }
+
     if (QFile(filePath()).remove()) {
         qDebug() << this->metaObject()->className() << "Deleted" << filePath();
         return true;
@@ -248,6 +608,66 @@ bool Variant::erase() {
     }
 }
 
+void Variant::probe() {
+    if (m_probed || m_url.isEmpty()) {
+        return;
+    }
+    m_probed = true;
+
+    const qint64 file_size = ImageFiles::instance()->size(filePath());
+    if (file_size != -1) {
+        setSize(file_size);
+
+        return;
+    }
+
+    auto image_probe = new ImageProbe(QUrl(url()), this);
+
+    connect(
+        image_probe, &ImageProbe::finished,
+        [this, image_probe]() {
+            m_volumeSize = image_probe->volumeSize();
+            m_lastModified = image_probe->lastModified();
+
+            qDebug() << this->metaObject()->className() << "Probed" << fileName() << "size =" << image_probe->size() << "volume size =" << m_volumeSize << "last modified =" << m_lastModified;
+
+            // NOTE: volume size of an ISO is close enough
+            // if server didn't report the size
+            if (image_probe->size() > 0) {
+                setSize(image_probe->size());
+            } else if (m_volumeSize > 0) {
+                setSize(m_volumeSize);
+            }
+
+            // Partial download of an older version of the
+            // image can't be resumed, the result would be
+            // a mix of two images
+            const QFileInfo part_info(filePath() + ".part");
+            const bool part_outdated = (part_info.exists() && m_lastModified.isValid() && part_info.lastModified() < m_lastModified);
+            if (part_outdated && m_status == PREPARING) {
+                qDebug() << this->metaObject()->className() << "Removing outdated partial download" << part_info.filePath();
+
+                QFile::remove(part_info.filePath());
+            }
+        });
+}
+
+// Image might have been downloaded, deleted or moved
+// outside of the app, or download directories were
+// listed for the first time
+void Variant::onImageFilesChanged(const QSet<QString> &file_names) {
+    const bool changed = (file_names.contains(fileName()) || file_names.contains(fileName() + ".part"));
+    const bool idle = (m_status == PREPARING || m_status == READY_FOR_WRITING);
+    const bool on_mirror = (!m_mirrorPath.isEmpty() && filePath() == m_mirrorPath);
+
+    if (!changed || !idle || on_mirror || downloadPending) {
+        return;
+    }
+
+    setFilePath(download_location_for_file(fileName(), size()));
+    resetStatus();
+}
+
 void Variant::setStatus(const Status status) {
     if (m_status != status) {
         m_status = status;
@@ -265,3 +685,60 @@ void Variant::setErrorString(const QString &error) {
         emit errorStringChanged();
     }
 }
+
+// NOTE: the check for mirror file is done when download
+// starts and not in the constructor because network
+// shares can be slow to access
+bool Variant::useMirror() {
+    if (m_mirrorPath.isEmpty()) {
+        return false;
+    }
+
+    const bool mirror_available = QFile::exists(m_mirrorPath);
+    const QString new_path = [this, mirror_available]() {
+        if (mirror_available) {
+            return m_mirrorPath;
+        } else {
+            return download_location_for_file(fileName(), size());
+        }
+    }();
+
+    if (mirror_available) {
+        qDebug() << this->metaObject()->className() << "Writing" << fileName() << "directly from" << m_mirrorPath;
+    } else {
+        qDebug() << this->metaObject()->className() << "Mirror path" << m_mirrorPath << "is not available, downloading instead";
+    }
+
+    setFilePath(new_path);
+
+    return mirror_available;
+}
+
+// Returns the path of the image on a locally mounted
+// mirror, if there is one. Urls that are already local
+// ("file://") are used as is.
+QString mirror_path_for_url(const QString &url, const QHash<QString, QString> &mirror_paths) {
+    const QUrl qurl(url);
+    if (qurl.isLocalFile()) {
+        return qurl.toLocalFile();
+    }
+
+    for (const QString &mirror_url : mirror_paths.keys()) {
+        const QString prefix = [mirror_url]() {
+            if (mirror_url.endsWith("/")) {
+                return mirror_url;
+            } else {
+                return mirror_url + "/";
+            }
+        }();
+
+        if (url.startsWith(prefix)) {
+            const QString relative_path = url.mid(prefix.length());
+            const QString out = QDir(mirror_paths[mirror_url]).filePath(relative_path);
+
+            return out;
+        }
+    }
+
+    return QString();
+}
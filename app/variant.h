@@ -28,40 +28,63 @@
  *
  * @property name the name of the variant which is generated from
  *     variant's architecture, board and live
- * @property filePath path to the image's file (after it is downloaded)
+ * @property filePath path to the image's file (after it is downloaded),
+ *     or the path on a local mirror if the image is available there
  * @property fileName the name of the image's file
  * @property fileTypeName display filetype name of the image's file
  * @property canWrite whether this image can be written, some file
  *     types aren't supported
  * @property progress the progress object of the image - reports the
  *     progress of download
+ * @property noMd5sum whether the image has no md5sum to check it
+ *     against, false until the md5sum is fetched
+ * @property size size of the image in bytes, 0 until it's known from
+ *     the probe or the download
+ * @property downloadEstimate estimated download time in seconds, -1
+ *     if it's unknown
+ * @property estimate estimated time in seconds to download the image
+ *     and write it to the selected drive, -1 if it's unknown
+ * @property recommended whether this variant is the fastest one to
+ *     get onto the drive out of the variants that are the same image
+ *     in different formats
  * @property status status of the variant - if it's downloading, being
  *     written, etc.
  * @property statusString string representation of the @ref status
  * @property errorString a string better describing the current error
  *     @ref status of the variant
+ *
+ * With direct write, the download is streamed to the drive.
  */
 
 #include "architecture.h"
 #include "file_type.h"
 
+#include <QDateTime>
 #include <QHash>
 #include <QList>
 #include <QObject>
+#include <QPointer>
+#include <QSet>
 #include <QString>
 
+class Drive;
+class ImageDownload;
 class Progress;
 
 class Variant final : public QObject {
     Q_OBJECT
-    Q_PROPERTY(QString name READ name CONSTANT)
-    Q_PROPERTY(QString filePath READ filePath CONSTANT)
+    Q_PROPERTY(QString name READ name NOTIFY detailsChanged)
+    Q_PROPERTY(QString filePath READ filePath NOTIFY fileChanged)
     Q_PROPERTY(QString fileName READ fileName CONSTANT)
-    Q_PROPERTY(QString fileTypeName READ fileTypeName CONSTANT)
-    Q_PROPERTY(bool canWrite READ canWrite CONSTANT)
-    Q_PROPERTY(bool noMd5sum READ noMd5sum CONSTANT)
-    Q_PROPERTY(bool isCompressed READ isCompressed CONSTANT)
+    Q_PROPERTY(QString fileTypeName READ fileTypeName NOTIFY detailsChanged)
+    Q_PROPERTY(bool canWrite READ canWrite NOTIFY detailsChanged)
+    Q_PROPERTY(bool noMd5sum READ noMd5sum NOTIFY md5sumChanged)
+    Q_PROPERTY(bool isCompressed READ isCompressed NOTIFY detailsChanged)
     Q_PROPERTY(Progress *progress READ progress CONSTANT)
+    Q_PROPERTY(qreal size READ size NOTIFY sizeChanged)
+    Q_PROPERTY(int downloadEstimate READ downloadEstimate NOTIFY sizeChanged)
+    Q_PROPERTY(int estimate READ estimate NOTIFY estimateChanged)
+    Q_PROPERTY(bool recommended READ recommended NOTIFY estimateChanged)
 
     Q_PROPERTY(Status status READ status NOTIFY statusChanged)
     Q_PROPERTY(QString statusString READ statusString NOTIFY statusChanged)
@@ -98,27 +121,54 @@ public:
         {WRITING_FAILED, tr("Error")},
     };
 
-    Variant(const QString &url, const Architecture arch, const FileType fileType, const QString &board, const bool live, const QString &md5sum, QObject *parent);
+    // NOTE: mirror paths from settings are passed in, so
+    // that they aren't read again for every variant
+    Variant(const QString &url, const QHash<QString, QString> &mirror_paths, const Architecture arch, const FileType fileType, const QString &board, const bool live, QObject *parent);
 
     // Constructor for local file
     Variant(const QString &path, QObject *parent);
 
+    // Updates details when metadata changes. The image
+    // might have changed too, so md5sum and size are
+    // found out again.
+    void update(const Architecture arch, const FileType fileType, const QString &board, const bool live);
+
     Q_INVOKABLE void setDelayedWrite(const bool value);
 
     Architecture arch() const;
     QString name() const;
+    QString board() const;
+    bool live() const;
 
     QString url() const;
     QString filePath() const;
     QString fileName() const;
     QString fileTypeName() const;
     QString md5sum() const;
+    // Whether md5sum is known, it's fetched when the
+    // variant is selected or downloaded
+    bool md5sumFetched() const;
+    void fetchMd5sum();
+    void setMd5sum(const QString &md5sum);
+    // Called when MD5SUM couldn't be downloaded
+    void setMd5sumFailed();
     bool canWrite() const;
     bool noMd5sum() const;
     bool isCompressed() const;
+    qint64 size() const;
+    int downloadEstimate() const;
+    int estimate() const;
+    bool recommended() const;
+    void setEstimate(const int estimate, const bool recommended);
+
+    // Whether the other variant is the same image,
+    // possibly in a different format
+    bool isEquivalent(const Variant *other) const;
     Progress *progress();
 
     Status status() const;
+    // Whether the image is being downloaded or written
+    bool isBusy() const;
     QString statusString() const;
     void setStatus(const Status status);
     QString errorString() const;
@@ -126,32 +176,63 @@ public:
 
     Q_INVOKABLE bool erase();
 
+    // Finds out the size of the image without
+    // downloading it, only done once
+    Q_INVOKABLE void probe();
+
 signals:
+    void detailsChanged();
     void fileChanged();
+    void sizeChanged();
+    void estimateChanged();
     void statusChanged();
     void errorStringChanged();
+    void md5sumChanged();
+    void md5sumFailed();
     void cancelledDownload();
+    void delayedWriteStarted();
 
 public slots:
     void download();
     void cancelDownload();
     void resetStatus();
     void onImageDownloadFinished();
+    void onImageFilesChanged(const QSet<QString> &file_names);
 
 private:
     QString m_url;
     QString m_fileName;
     QString m_filePath;
+    QString m_mirrorPath;
     QString m_board;
     bool m_live;
     QString m_md5sum;
+    bool m_md5sumFetched;
+    bool downloadPending;
+    bool writePending;
     Architecture m_arch;
     FileType m_fileType;
     Status m_status;
     QString m_error;
     bool delayedWrite;
+    qint64 m_size;
+    qint64 m_volumeSize;
+    QDateTime m_lastModified;
+    bool m_probed;
+    int m_estimate;
+    bool m_recommended;
+    QPointer<Drive> streamDrive;
 
     Progress *m_progress;
+
+    void setFilePath(const QString &path);
+    void setSize(const qint64 size);
+    void resetMd5sum();
+    void continueDownload();
+    void startDownload();
+    void streamToDrive(Drive *drive);
+    bool useMirror();
+    void connectImageDownload(ImageDownload *download);
 };
 
 #endif // VARIANT_H
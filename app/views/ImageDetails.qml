@@ -145,6 +145,22 @@ Item {
                                 visible: releases.selected.variant
                                 text: releases.selected.variant && releases.selected.variant.fileTypeName
                             }
+                            Text {
+                                font.pointSize: 8
+                                color: mixColors(palette.window, palette.windowText, 0.3)
+                                visible: releases.selected.variant && releases.selected.variant.size > 0
+                                property double imageSize: releases.selected.variant ? releases.selected.variant.size : 0
+                                property int estimate: releases.selected.variant ? releases.selected.variant.downloadEstimate : -1
+                                property int totalEstimate: releases.selected.variant ? releases.selected.variant.estimate : -1
+                                property string sizeStr: (imageSize < (1024 * 1024 * 1024)) ? qsTr("%1 MB").arg((imageSize / 1024 / 1024).toFixed(1)) :
+                                                                                               qsTr("%1 GB").arg((imageSize / 1024 / 1024 / 1024).toFixed(1))
+                                property string estimateStr: (totalEstimate >= 0) ? ((totalEstimate < 60) ? qsTr("(less than a minute to download and write)") :
+                                                                                                            qsTr("(about %1 min to download and write)").arg(Math.ceil(totalEstimate / 60))) :
+                                                             (estimate < 0)       ? "" :
+                                                             (estimate < 60)      ? qsTr("(less than a minute to download)") :
+                                                                                    qsTr("(about %1 min to download)").arg(Math.ceil(estimate / 60))
+                                text: sizeStr + (estimateStr.length > 0 ? (" " + estimateStr) : "")
+                            }
                             RowLayout {
                                 spacing: 0
                                 width: parent.width
@@ -203,7 +219,7 @@ Item {
                                             Repeater {
                                                 model: releases.selected.variants
                                                 AdwaitaRadioButton {
-                                                    text: name
+                                                    text: name + " " + fileTypeName + (recommended ? " " + qsTr("(fastest)") : "")
                                                     Layout.alignment: Qt.AlignVCenter
                                                     exclusiveGroup: otherVariantsExclusiveGroup
                                                     checked: index == releases.selected.variantIndex
@@ -411,12 +411,15 @@ void WinDrive::onReadyRead() {
             // Set progress bar max value at start of writing
             const QFile file(m_variant->filePath());
             m_progress->setMax(file.size());
+            startWriteMeasurement();
         } else if (line == "DONE") {
+            finishWriteMeasurement(QFile(m_variant->filePath()).size());
             m_variant->setStatus(Variant::WRITING_FINISHED);
             Notifications::notify(tr("Finished!"), tr("Writing %1 was successful").arg(m_variant->fileName()));
         } else if (line == "CHECK") {
             qDebug() << this->metaObject()->className() << "Written media check starting";
             const QFile file(m_variant->filePath());
+            finishWriteMeasurement(file.size());
             m_progress->setMax(file.size());
             m_progress->setCurrent(0);
             m_variant->setStatus(Variant::WRITE_VERIFYING);
@@ -0,0 +1,38 @@
+TEMPLATE = app
+
+TARGET = download_benchmark
+
+QT += network
+QT -= gui
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+APP_DIR = $$PWD/../../../app
+INCLUDEPATH += $$APP_DIR
+
+# NOTE: only the parts of the app that ImageDownload
+# needs are built
+HEADERS += \
+    $$APP_DIR/image_download.h \
+    $$APP_DIR/metadata_cache.h \
+    $$APP_DIR/network.h \
+    $$APP_DIR/settings.h \
+    $$APP_DIR/throughput.h \
+    $$APP_DIR/trace.h
+
+SOURCES += main.cpp \
+    $$APP_DIR/image_download.cpp \
+    $$APP_DIR/metadata_cache.cpp \
+    $$APP_DIR/network.cpp \
+    $$APP_DIR/settings.cpp \
+    $$APP_DIR/throughput.cpp \
+    $$APP_DIR/trace.cpp
+
+linux {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += liblzma
+}
+win32 {
+    LIBS += -llzma
+}
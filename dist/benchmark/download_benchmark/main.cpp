@@ -0,0 +1,267 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+/*
+ * Downloads an image with ImageDownload a few times and
+ * reports how it went: speed, CPU time per MB, time until
+ * the image was verified and how many times the download
+ * was interrupted and resumed. Meant to be run against
+ * test_server.py, see BUILDING.md.
+ */
+
+#include "image_download.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QTimer>
+#include <QUrl>
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif // Q_OS_UNIX
+
+struct RunResult {
+    ImageDownload::Result result;
+    QString error_string;
+    qint64 bytes;
+    qint64 first_byte_msecs;
+    qint64 downloaded_msecs;
+    qint64 verified_msecs;
+    qint64 cpu_msecs;
+    int interrupted_count;
+    bool timed_out;
+};
+
+static RunResult run_download(const QUrl &url, const QString &md5sum, const qint64 rate_limit, const int time_out_secs);
+static QString result_name(const ImageDownload::Result result);
+static qint64 process_cpu_msecs();
+
+int main(int argc, char **argv) {
+    QCoreApplication app(argc, argv);
+
+    // NOTE: ImageDownload records throughput in the
+    // settings, keep that away from the app's settings
+    QCoreApplication::setOrganizationName("BaseALT");
+    QCoreApplication::setApplicationName("ALTMediaWriterDownloadBenchmark");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Benchmark for image downloads");
+    parser.addHelpOption();
+    parser.addPositionalArgument("url", "Url of the image");
+    const QCommandLineOption md5_option("md5", "Md5 sum of the image, check is skipped if not given", "md5");
+    const QCommandLineOption runs_option("runs", "How many times to download the image", "count", "3");
+    const QCommandLineOption rate_option("rate-limit", "Limit download speed to this many bytes per second, like prefetch does", "bytes", "0");
+    const QCommandLineOption time_out_option("time-out", "Give up on a download after this many seconds", "seconds", "300");
+    parser.addOption(md5_option);
+    parser.addOption(runs_option);
+    parser.addOption(rate_option);
+    parser.addOption(time_out_option);
+    parser.process(app);
+
+    if (parser.positionalArguments().size() != 1) {
+        parser.showHelp(1);
+    }
+
+    const QUrl url(parser.positionalArguments().first());
+    const QString md5sum = parser.value(md5_option);
+    const int runs = qMax(1, parser.value(runs_option).toInt());
+    const qint64 rate_limit = parser.value(rate_option).toLongLong();
+    const int time_out_secs = parser.value(time_out_option).toInt();
+
+    QTextStream out(stdout);
+
+    int success_count = 0;
+    double speed_total = 0;
+
+    for (int run = 1; run <= runs; run++) {
+        const RunResult result = run_download(url, md5sum, rate_limit, time_out_secs);
+
+        const double megabytes = result.bytes / (1024.0 * 1024.0);
+        const double download_secs = qMax((qint64) 1, result.downloaded_msecs) / 1000.0;
+        const double speed = megabytes / download_secs;
+        const double cpu_per_mb = [&]() -> double {
+            if (result.cpu_msecs >= 0 && megabytes > 0) {
+                return result.cpu_msecs / megabytes;
+            } else {
+                return -1;
+            }
+        }();
+
+        out << "Run " << run << ": " << result_name(result.result);
+        if (result.timed_out) {
+            out << " (timed out)";
+        }
+        if (!result.error_string.isEmpty()) {
+            out << " \"" << result.error_string << "\"";
+        }
+        out << "\n";
+        out << "    downloaded " << megabytes << " MB at " << speed << " MB/s\n";
+        out << "    first byte after " << result.first_byte_msecs << " ms, verified after " << result.verified_msecs << " ms\n";
+        out << "    CPU time " << cpu_per_mb << " ms per MB\n";
+        out << "    interrupted and resumed " << result.interrupted_count << " times\n";
+        out.flush();
+
+        if (result.result == ImageDownload::Success) {
+            success_count++;
+            speed_total += speed;
+        }
+    }
+
+    out << "Succeeded " << success_count << " of " << runs << " runs";
+    if (success_count > 0) {
+        out << ", average speed " << (speed_total / success_count) << " MB/s";
+    }
+    out << "\n";
+
+    if (success_count == runs) {
+        return 0;
+    } else {
+        return 1;
+    }
+}
+
+// NOTE: every run downloads into a new temporary dir, so
+// that nothing is resumed from the previous run
+RunResult run_download(const QUrl &url, const QString &md5sum, const qint64 rate_limit, const int time_out_secs) {
+    RunResult out;
+    out.result = ImageDownload::Cancelled;
+    out.bytes = 0;
+    out.first_byte_msecs = -1;
+    out.downloaded_msecs = -1;
+    out.verified_msecs = -1;
+    out.interrupted_count = 0;
+    out.timed_out = false;
+
+    const QTemporaryDir dir;
+    const QString file_path = QDir(dir.path()).filePath(url.fileName());
+
+    QElapsedTimer timer;
+    timer.start();
+    const qint64 cpu_start = process_cpu_msecs();
+
+    // NOTE: connections are made in the context of the
+    // loop, so that they go away with it
+    QEventLoop loop;
+    auto download = new ImageDownload(url, file_path, md5sum);
+    download->setRateLimit(rate_limit);
+
+    QObject::connect(
+        download, &ImageDownload::started,
+        &loop, [&]() {
+            if (out.first_byte_msecs == -1) {
+                out.first_byte_msecs = timer.elapsed();
+            }
+        });
+    QObject::connect(
+        download, &ImageDownload::interrupted,
+        &loop, [&]() {
+            out.interrupted_count++;
+        });
+    QObject::connect(
+        download, &ImageDownload::progress,
+        &loop, [&](const qint64 value) {
+            if (out.downloaded_msecs == -1) {
+                out.bytes = value;
+            }
+        });
+    QObject::connect(
+        download, &ImageDownload::startedMd5Check,
+        &loop, [&]() {
+            out.downloaded_msecs = timer.elapsed();
+        });
+    QObject::connect(
+        download, &ImageDownload::finished,
+        &loop, [&]() {
+            out.result = download->result();
+            out.error_string = download->errorString();
+            out.verified_msecs = timer.elapsed();
+
+            if (out.downloaded_msecs == -1) {
+                out.downloaded_msecs = out.verified_msecs;
+            }
+            if (out.result == ImageDownload::Success) {
+                out.bytes = QFileInfo(file_path).size();
+            }
+
+            loop.quit();
+        });
+
+    // NOTE: ImageDownload keeps resuming after errors
+    // forever, so a broken server has to be given up on
+    QTimer time_out_timer;
+    time_out_timer.setSingleShot(true);
+    QObject::connect(
+        &time_out_timer, &QTimer::timeout,
+        download, [&]() {
+            out.timed_out = true;
+            download->cancel();
+        });
+    time_out_timer.start(time_out_secs * 1000);
+
+    loop.exec();
+
+    const qint64 cpu_end = process_cpu_msecs();
+    if (cpu_start >= 0 && cpu_end >= 0) {
+        out.cpu_msecs = cpu_end - cpu_start;
+    } else {
+        out.cpu_msecs = -1;
+    }
+
+    return out;
+}
+
+QString result_name(const ImageDownload::Result result) {
+    switch (result) {
+        case ImageDownload::Success: return "Success";
+        case ImageDownload::DiskError: return "DiskError";
+        case ImageDownload::Md5CheckFail: return "Md5CheckFail";
+        case ImageDownload::NetworkError: return "NetworkError";
+        case ImageDownload::Cancelled: return "Cancelled";
+    }
+
+    return QString();
+}
+
+// Returns CPU time used by the whole process, or -1 if
+// it's not available on this system
+qint64 process_cpu_msecs() {
+#ifdef Q_OS_UNIX
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return -1;
+    }
+
+    const qint64 user_msecs = usage.ru_utime.tv_sec * 1000 + usage.ru_utime.tv_usec / 1000;
+    const qint64 system_msecs = usage.ru_stime.tv_sec * 1000 + usage.ru_stime.tv_usec / 1000;
+
+    return user_msecs + system_msecs;
+#else
+    return -1;
+#endif // Q_OS_UNIX
+}
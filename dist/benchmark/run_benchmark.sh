@@ -0,0 +1,75 @@
+#!/bin/bash
+
+# Runs the download benchmark against the local test
+# server in a few scenarios: a fast server, limited
+# bandwidth, high latency, connections dropped in the
+# middle of the image and a missing image. Build the
+# benchmark first, see BUILDING.md.
+#
+# Usage: ./run_benchmark.sh path/to/download_benchmark [image size in MB]
+
+# Check that we're running script from it's directory
+if [ ! -f run_benchmark.sh ]
+then
+	echo "Error: run run_benchmark.sh from it's directory"
+	exit 1
+fi
+
+benchmark="$1"
+size_mb="${2:-256}"
+port=8765
+
+if [ ! -x "$benchmark" ]
+then
+	echo "Error: benchmark binary \"$benchmark\" not found"
+	exit 1
+fi
+
+image_dir=$(mktemp -d)
+server_pid=""
+
+cleanup() {
+	if [ -n "$server_pid" ]
+	then
+		kill "$server_pid" 2> /dev/null
+		wait "$server_pid" 2> /dev/null
+	fi
+	rm -rf "$image_dir"
+}
+trap cleanup EXIT
+
+# NOTE: random data, so that nothing along the way can
+# compress it
+head -c "$((size_mb * 1024 * 1024))" /dev/urandom > "$image_dir/image.iso"
+md5=$(md5sum "$image_dir/image.iso" | cut -d " " -f 1)
+url="http://127.0.0.1:$port/image.iso"
+
+# Usage: run_scenario name "server options" "benchmark options"
+run_scenario() {
+	name="$1"
+	server_options="$2"
+	benchmark_options="$3"
+
+	echo "=== $name"
+
+	# shellcheck disable=SC2086
+	./test_server.py --quiet --port "$port" $server_options "$image_dir" &
+	server_pid=$!
+	sleep 1
+
+	# shellcheck disable=SC2086
+	"$benchmark" --md5 "$md5" $benchmark_options "$url"
+
+	kill "$server_pid"
+	wait "$server_pid" 2> /dev/null
+	server_pid=""
+
+	echo
+}
+
+run_scenario "Fast server" "" ""
+run_scenario "Limited bandwidth, 4 MB/s" "--rate $((4 * 1024 * 1024))" "--runs 1"
+run_scenario "High latency, 300 ms" "--latency 300" ""
+run_scenario "Every other connection dropped after 32 MB" "--drop-after $((32 * 1024 * 1024)) --drop-every 2" ""
+run_scenario "Rate limited download, like prefetch, 8 MB/s" "" "--runs 1 --rate-limit $((8 * 1024 * 1024))"
+run_scenario "Missing image" "--missing image.iso" "--runs 1 --time-out 10"
@@ -0,0 +1,172 @@
+#!/usr/bin/env python3
+
+# Local HTTP server that stands in for getalt.org when
+# measuring downloads. Serves files from a directory with
+# support for range requests, like a real mirror, and can
+# make the connection worse on purpose: limit bandwidth,
+# add latency, drop connections in the middle of a
+# response and answer 404 for some paths.
+#
+# Usage: ./test_server.py [options] directory
+#
+# Only uses the python standard library.
+
+import argparse
+import os
+import re
+import socketserver
+import sys
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, HTTPServer
+
+CHUNK_SIZE = 64 * 1024
+
+
+class ThreadingServer(socketserver.ThreadingMixIn, HTTPServer):
+    daemon_threads = True
+    allow_reuse_address = True
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    # Set from the command line in main()
+    options = None
+    request_count = 0
+    request_count_lock = threading.Lock()
+
+    def do_HEAD(self):
+        self.handle_request(False)
+
+    def do_GET(self):
+        self.handle_request(True)
+
+    def handle_request(self, send_body):
+        with Handler.request_count_lock:
+            Handler.request_count += 1
+            request_number = Handler.request_count
+
+        options = Handler.options
+
+        if options.latency > 0:
+            time.sleep(options.latency / 1000.0)
+
+        path = self.path.split("?", 1)[0].lstrip("/")
+        file_path = os.path.realpath(os.path.join(options.directory, path))
+        in_directory = file_path.startswith(os.path.realpath(options.directory) + os.sep)
+
+        missing = any(re.search(pattern, path) for pattern in options.missing)
+        if missing or not in_directory or not os.path.isfile(file_path):
+            self.send_error(404)
+
+            return
+
+        size = os.path.getsize(file_path)
+        start, end = 0, size - 1
+
+        # NOTE: only the "bytes=N-" and "bytes=N-M" forms
+        # are supported, that's what the app sends
+        range_header = self.headers.get("Range")
+        range_match = re.match(r"bytes=(\d+)-(\d*)$", range_header or "")
+        if range_match:
+            start = int(range_match.group(1))
+            if range_match.group(2):
+                end = min(int(range_match.group(2)), size - 1)
+
+            if start >= size:
+                self.send_response(416)
+                self.send_header("Content-Range", "bytes */%d" % size)
+                self.send_header("Content-Length", "0")
+                self.end_headers()
+
+                return
+
+            self.send_response(206)
+            self.send_header("Content-Range", "bytes %d-%d/%d" % (start, end, size))
+        else:
+            self.send_response(200)
+
+        length = end - start + 1
+        self.send_header("Content-Length", str(length))
+        self.send_header("Content-Type", "application/octet-stream")
+        self.send_header("Accept-Ranges", "bytes")
+        self.end_headers()
+
+        if not send_body:
+            return
+
+        # Every n'th request is dropped after this many
+        # bytes
+        drop_after = -1
+        if options.drop_after > 0 and request_number % options.drop_every == 0:
+            drop_after = options.drop_after
+
+        sent = 0
+        started = time.monotonic()
+
+        with open(file_path, "rb") as f:
+            f.seek(start)
+
+            while sent < length:
+                chunk_size = min(CHUNK_SIZE, length - sent)
+                if drop_after >= 0:
+                    chunk_size = min(chunk_size, drop_after - sent)
+
+                if chunk_size <= 0:
+                    self.log_message("Dropping connection after %d bytes", sent)
+                    self.close_connection = True
+
+                    return
+
+                data = f.read(chunk_size)
+                if not data:
+                    break
+
+                try:
+                    self.wfile.write(data)
+                except (BrokenPipeError, ConnectionResetError):
+                    return
+
+                sent += len(data)
+
+                # Sleep until the average speed is back
+                # under the limit
+                if options.rate > 0:
+                    ahead = sent / options.rate - (time.monotonic() - started)
+                    if ahead > 0:
+                        time.sleep(ahead)
+
+    def log_message(self, format, *args):
+        if not Handler.options.quiet:
+            super().log_message(format, *args)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Local HTTP server for download tests")
+    parser.add_argument("directory", help="directory to serve")
+    parser.add_argument("--port", type=int, default=8000)
+    parser.add_argument("--rate", type=int, default=0, help="bandwidth limit per connection in bytes per second, 0 for no limit")
+    parser.add_argument("--latency", type=int, default=0, help="delay before each response in milliseconds")
+    parser.add_argument("--drop-after", type=int, default=0, help="close the connection after sending this many bytes of a response")
+    parser.add_argument("--drop-every", type=int, default=1, help="only drop every n'th request, so that resumed downloads can make progress")
+    parser.add_argument("--missing", action="append", default=[], help="answer 404 for paths matching this regex, can be given multiple times")
+    parser.add_argument("--quiet", action="store_true", help="don't log requests")
+    options = parser.parse_args()
+
+    if options.drop_every < 1:
+        parser.error("--drop-every must be at least 1")
+
+    Handler.options = options
+
+    server = ThreadingServer(("127.0.0.1", options.port), Handler)
+    print("Serving %s on http://127.0.0.1:%d" % (options.directory, options.port), file=sys.stderr)
+
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,89 @@
+#!/bin/bash
+
+# Generates a large synthetic catalog to measure how
+# loading the catalog scales with its size. See "Large
+# catalogs" in BUILDING.md for how to use it.
+#
+# Usage: ./generate_synthetic_catalog.sh <dir> [releases] [variants per release]
+
+if [ $# -lt 1 ]
+then
+	echo "Usage: $0 <dir> [releases] [variants per release]"
+	exit 1
+fi
+
+out_dir=$(realpath -m "$1")
+release_count="${2:-2000}"
+variants_per_release="${3:-10}"
+
+# Releases are split between multiple sections and
+# images files, like on the real server
+releases_per_file=100
+
+# NOTE: icons have to exist in the app's resources
+icons=(alt-edu alt-server-v simply alt-workstation alt-kworkstation starterkits)
+arches=(x86_64 i586 aarch64 armh riscv64 e2k ppc64le mipsel)
+extensions=(iso img.xz tar.xz img recovery.tar)
+
+host="file://$out_dir"
+
+rm -rf "$out_dir"
+mkdir -p "$out_dir/sections" "$out_dir/images"
+
+section_list="$out_dir/altmediawriter_section_url_list.txt"
+image_list="$out_dir/altmediawriter_image_url_list.txt"
+
+for ((file = 0; file * releases_per_file < release_count; file++))
+do
+	section_file="sections/section-$file.yml"
+	images_file="images/images-$file.yml"
+
+	echo "$host/$section_file" >> "$section_list"
+	echo "$host/$images_file" >> "$image_list"
+
+	echo "members:" > "$out_dir/$section_file"
+	echo "entries:" > "$out_dir/$images_file"
+
+	first=$((file * releases_per_file))
+	last=$((first + releases_per_file))
+	if [ $last -gt "$release_count" ]
+	then
+		last=$release_count
+	fi
+
+	for ((i = first; i < last; i++))
+	do
+		name="synthetic-$i"
+		icon=${icons[$((i % ${#icons[@]}))]}
+
+		# NOTE: printf is a builtin, so this is fast
+		# enough for tens of thousands of entries
+		printf "  - code: %s\n    img: %s\n" "$name" "$icon" >> "$out_dir/$section_file"
+		for language in en ru
+		do
+			printf "    name_%s: Synthetic Edition %d\n" "$language" "$i"
+			printf "    descr_%s: Summary of synthetic edition %d\n" "$language" "$i"
+			printf "    descr_full_%s: Description of synthetic edition %d for catalog scaling tests\n" "$language" "$i"
+		done >> "$out_dir/$section_file"
+
+		image_dir="images/$name"
+		mkdir -p "$out_dir/$image_dir"
+
+		for ((j = 0; j < variants_per_release; j++))
+		do
+			arch=${arches[$((j % ${#arches[@]}))]}
+			extension=${extensions[$(((j / ${#arches[@]}) % ${#extensions[@]}))]}
+			live=$(((j / ${#arches[@]}) % 2))
+			image_name="$name-build$j-$arch.$extension"
+
+			printf "  - link: %s\n    solution: %s\n    arch: %s\n    live: %d\n" "$host/$image_dir/$image_name" "$name" "$arch" "$live" >> "$out_dir/$images_file"
+
+			# NOTE: sums are fake, images don't exist
+			printf -v md5 "%032x" $((i * variants_per_release + j))
+			echo "$md5 $image_name" >> "$out_dir/$image_dir/MD5SUM"
+		done
+	done
+done
+
+echo "Generated $release_count releases with $((release_count * variants_per_release)) variants in $out_dir"
+echo "Set metadataHost=$host in the config file to use them"
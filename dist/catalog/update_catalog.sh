@@ -0,0 +1,57 @@
+#!/bin/bash
+
+# Downloads the current catalog and saves it as a snapshot
+# that is built into the app. The app shows the built-in
+# catalog on the first start until the catalog is
+# downloaded, so that it works without network. Run
+# before making a release and commit the results.
+#
+# Usage: ./update_catalog.sh [host]
+
+# Check that we're running script from it's directory
+if [ ! -f update_catalog.sh ]
+then
+	echo "Error: run update_catalog.sh from it's directory"
+	exit 1
+fi
+
+host="${1:-http://getalt.org}"
+out_dir="../../app/assets/catalog"
+
+rm -rf "$out_dir"
+mkdir -p "$out_dir"
+
+# NOTE: files are named by md5 of their url, same as in
+# the app's metadata cache
+save_list() {
+	group="$1"
+	list_url="$2"
+
+	urls=$(curl --fail --silent --show-error "$list_url") || exit 1
+
+	for url in $urls
+	do
+		name=$(printf "%s" "$url" | md5sum | cut -d " " -f 1)
+
+		curl --fail --silent --show-error "$url" --output "$out_dir/$name" || exit 1
+
+		echo "$group $url" >> "$out_dir/snapshot"
+		echo "        <file alias=\"$name\">$name</file>" >> "$out_dir/files"
+	done
+}
+
+save_list section "$host/altmediawriter_section_url_list.txt"
+save_list image "$host/altmediawriter_image_url_list.txt"
+
+{
+	echo "<RCC>"
+	echo "    <qresource prefix=\"/catalog\">"
+	echo "        <file alias=\"snapshot\">snapshot</file>"
+	cat "$out_dir/files"
+	echo "    </qresource>"
+	echo "</RCC>"
+} > "$out_dir/catalog.qrc"
+
+rm "$out_dir/files"
+
+echo "Saved catalog to $out_dir"
@@ -38,6 +38,14 @@ int main(int argc, char *argv[]) {
         new RestoreJob(app.arguments()[2]);
     } else if (app.arguments().count() == 5 && app.arguments()[1] == "write") {
         new WriteJob(app.arguments()[2], app.arguments()[3], app.arguments()[4]);
+    } else if (app.arguments().count() == 6 && app.arguments()[1] == "write") {
+        // NOTE: last argument is where to keep a
+        // decompressed copy of a compressed image
+        new WriteJob(app.arguments()[2], app.arguments()[3], app.arguments()[4], false, app.arguments()[5]);
+    } else if (app.arguments().count() == 5 && app.arguments()[1] == "stream") {
+        // NOTE: image data comes from stdin, the image
+        // name is only used to detect compression
+        new WriteJob(app.arguments()[2], app.arguments()[3], app.arguments()[4], true);
     } else {
         QTextStream err(stderr);
         err << "Helper: Wrong arguments entered";
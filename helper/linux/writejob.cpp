@@ -23,15 +23,18 @@
 #include "writejob.h"
 
 #include <QCoreApplication>
+#include <QCryptographicHash>
 #include <QDBusInterface>
 #include <QDBusUnixFileDescriptor>
 #include <QProcess>
 #include <QTextStream>
+#include <QThread>
 #include <QTimer>
 #include <QtDBus>
 #include <QtGlobal>
 
 #include <errno.h>
+#include <string.h>
 #include <sys/fcntl.h>
 #include <unistd.h>
 
@@ -61,20 +64,88 @@ public:
     size_t size;
 };
 
-WriteJob::WriteJob(const QString &what, const QString &where, const QString &md5_arg)
+// NOTE: when writing is delayed, the image is still being
+// downloaded into a ".part" file. The download only ever
+// appends, so everything up to the current size of the
+// file is final. ImageSource follows that watermark and
+// waits for more data until the download renames the
+// ".part" file to the final name. Renaming doesn't affect
+// the open descriptor, so reading simply continues.
+//
+// In stream mode the image is piped into stdin by the
+// app as it is downloaded, so it's read from there
+// instead.
+class ImageSource {
+public:
+    ImageSource(const QString &path, const bool from_stdin);
+    ~ImageSource();
+
+    bool open();
+
+    // Blocks until the buffer is full, the end of the
+    // finished image is reached or an error occurs.
+    // Returns -1 on error.
+    qint64 read(void *data, const qint64 max_size);
+
+    bool downloadFinished();
+    bool atEnd() const;
+    QString errorString() const;
+
+    // Md5 of everything that was read so far
+    QString md5();
+
+private:
+    QString final_path;
+    QString part_path;
+    bool stdin_mode;
+    int fd;
+    bool growing;
+    bool at_end;
+    QString error_string;
+    QCryptographicHash hash;
+
+    bool updateGrowing();
+};
+
+// NOTE: keeps a decompressed copy of a compressed image
+// so that the app can write it without decompressing
+// next time. Blocks of zeroes are skipped to keep the
+// copy sparse. Next to the copy, a ".md5" file records
+// md5 of the decompressed data and of the compressed
+// image. Errors only drop the copy, they never fail the
+// write.
+class CacheWriter {
+public:
+    explicit CacheWriter(const QString &path);
+    ~CacheWriter();
+
+    void write(const void *data, const qint64 size);
+
+    // Should be called after the source was verified
+    void finish(const QString &source_md5);
+
+private:
+    QString final_path;
+    QFile file;
+    qint64 total;
+    bool active;
+    QCryptographicHash hash;
+};
+
+WriteJob::WriteJob(const QString &what, const QString &where, const QString &md5_arg, const bool stream_arg, const QString &cache_path_arg)
 : QObject(nullptr)
 , what(what)
 , where(where)
-, md5(md5_arg) {
+, md5(md5_arg)
+, stream(stream_arg)
+, cache_path(cache_path_arg) {
     qDBusRegisterMetaType<Properties>();
     qDBusRegisterMetaType<InterfacesAndProperties>();
     qDBusRegisterMetaType<DBusIntrospection>();
 
     fd = QDBusUnixFileDescriptor(-1);
+    write_announced = false;
 
-    connect(
-        &watcher, &QFileSystemWatcher::fileChanged,
-        this, &WriteJob::onFileChanged);
     QTimer::singleShot(0, this, SLOT(work()));
 }
 
@@ -152,8 +223,10 @@ bool WriteJob::writeCompressed(int fd) {
     const PageAlignedBuffer inBuffer;
     const PageAlignedBuffer outBuffer;
 
-    QFile file(what);
-    const bool open_success = file.open(QIODevice::ReadOnly);
+    CacheWriter cache(cache_path);
+
+    ImageSource source(what, stream);
+    const bool open_success = source.open();
     if (!open_success) {
         err << tr("Source image is not readable") << what;
         err.flush();
@@ -173,15 +246,23 @@ bool WriteJob::writeCompressed(int fd) {
     strm.avail_out = outBuffer.size;
 
     while (true) {
+        // NOTE: the decoder consumes input as it arrives,
+        // so a still downloading image is decompressed
+        // incrementally
         if (strm.avail_in == 0) {
-            qint64 len = file.read((char *) inBuffer.buffer, inBuffer.size);
+            qint64 len = source.read(inBuffer.buffer, inBuffer.size);
+            if (len < 0) {
+                err << source.errorString();
+                err.flush();
+                qApp->exit(2);
+                return false;
+            }
             totalRead += len;
 
             strm.next_in = (uint8_t *) inBuffer.buffer;
             strm.avail_in = len;
 
-            out << totalRead << "\n";
-            out.flush();
+            reportProgress(source, totalRead);
         }
 
         ret = lzma_code(&strm, strm.avail_in == 0 ? LZMA_FINISH : LZMA_RUN);
@@ -192,7 +273,14 @@ bool WriteJob::writeCompressed(int fd) {
                 qApp->exit(3);
                 return false;
             }
-            return true;
+            cache.write(outBuffer.buffer, len);
+
+            const bool source_valid = checkSourceMd5(source);
+            if (source_valid) {
+                cache.finish(source.md5());
+            }
+
+            return source_valid;
         }
         if (ret != LZMA_OK) {
             switch (ret) {
@@ -222,6 +310,7 @@ bool WriteJob::writeCompressed(int fd) {
                 qApp->exit(3);
                 return false;
             }
+            cache.write(outBuffer.buffer, len);
             strm.next_out = (uint8_t *) outBuffer.buffer;
             strm.avail_out = outBuffer.size;
         }
@@ -232,8 +321,8 @@ bool WriteJob::writePlain(int fd) {
     QTextStream out(stdout);
     QTextStream err(stderr);
 
-    QFile inFile(what);
-    const bool open_success = inFile.open(QIODevice::ReadOnly);
+    ImageSource source(what, stream);
+    const bool open_success = source.open();
     if (!open_success) {
         err << tr("Source image is not readable") << what;
         err.flush();
@@ -244,10 +333,10 @@ bool WriteJob::writePlain(int fd) {
     const PageAlignedBuffer buffer;
     qint64 total = 0;
 
-    while (!inFile.atEnd()) {
-        qint64 len = inFile.read((char *) buffer.buffer, buffer.size);
+    while (!source.atEnd()) {
+        qint64 len = source.read(buffer.buffer, buffer.size);
         if (len < 0) {
-            err << tr("Source image is not readable");
+            err << source.errorString();
             err.flush();
             qApp->exit(3);
             return false;
@@ -270,14 +359,12 @@ bool WriteJob::writePlain(int fd) {
             return false;
         }
         total += len;
-        out << total << '\n';
-        out.flush();
+        reportProgress(source, total);
     }
 
-    inFile.close();
     sync();
 
-    return true;
+    return checkSourceMd5(source);
 }
 
 bool WriteJob::check(int fd) {
@@ -330,31 +417,15 @@ bool WriteJob::check(int fd) {
 }
 
 void WriteJob::work() {
-    QTextStream out(stdout);
-    QTextStream err(stderr);
-
     // have to keep the QDBus wrapper, otherwise the file gets closed
     fd = getDescriptor();
     if (fd.fileDescriptor() < 0) {
         return;
     }
 
-    const bool delayed_write = [&]() {
-        const QString part_path = what + ".part";
-
-        return (QFile::exists(part_path) && !QFile::exists(what));
-    }();
-
-    if (delayed_write) {
-        watcher.addPath(what + ".part");
-
-        return;
-    }
-
-    // NOTE: let the app know that writing started
-    out << "WRITE\n";
-    out.flush();
-
+    // NOTE: if the image is still downloading, writing
+    // starts right away and follows the download, see
+    // ImageSource
     const bool write_success = write(fd.fileDescriptor());
 
     if (write_success) {
@@ -364,31 +435,49 @@ void WriteJob::work() {
     }
 }
 
-void WriteJob::onFileChanged(const QString &path) {
-    QTextStream out(stdout);
+// NOTE: source is verified while it's being written
+// because images written from a mirror or a network
+// share skip the download check, and compressed images
+// can't be checked after writing.
+bool WriteJob::checkSourceMd5(ImageSource &source) {
     QTextStream err(stderr);
 
-    const bool still_downloading = QFile::exists(path);
-    if (still_downloading) {
-        return;
+    if (md5.isEmpty()) {
+        return true;
     }
 
-    const bool downloaded_file_exists = QFile::exists(what);
-    if (!downloaded_file_exists) {
-        qApp->exit(4);
-        return;
+    const QString source_md5 = source.md5();
+    if (source_md5 == md5) {
+        return true;
     }
 
-    out << "WRITE\n";
-    out.flush();
+    err << tr("The source image is corrupted.") << "\n";
+    err.flush();
+    qApp->exit(4);
 
-    const bool write_success = write(fd.fileDescriptor());
+    return false;
+}
 
-    if (write_success) {
-        check(fd.fileDescriptor());
-    } else {
-        qApp->exit(4);
+// NOTE: while the image is still downloading, the app
+// shows download progress, so writing is reported only
+// after the download finishes. At that point the app
+// switches to write progress, which continues from
+// however much was already written.
+void WriteJob::reportProgress(ImageSource &source, const qint64 total) {
+    QTextStream out(stdout);
+
+    if (!source.downloadFinished()) {
+        return;
+    }
+
+    if (!write_announced) {
+        write_announced = true;
+
+        out << "WRITE\n";
     }
+
+    out << total << "\n";
+    out.flush();
 }
 
 PageAlignedBuffer::PageAlignedBuffer(const size_t page_count) {
@@ -408,3 +497,201 @@ PageAlignedBuffer::PageAlignedBuffer(const size_t page_count) {
 PageAlignedBuffer::~PageAlignedBuffer() {
     free(unaligned_buffer);
 }
+
+ImageSource::ImageSource(const QString &path, const bool from_stdin)
+: hash(QCryptographicHash::Md5) {
+    final_path = path;
+    part_path = path + ".part";
+    stdin_mode = from_stdin;
+    fd = -1;
+    growing = false;
+    at_end = false;
+}
+
+// NOTE: stdin is not ours to close
+ImageSource::~ImageSource() {
+    if (fd >= 0 && !stdin_mode) {
+        ::close(fd);
+    }
+}
+
+bool ImageSource::open() {
+    if (stdin_mode) {
+        fd = STDIN_FILENO;
+
+        return true;
+    }
+
+    growing = (QFile::exists(part_path) && !QFile::exists(final_path));
+
+    const QString open_path = (growing ? part_path : final_path);
+    fd = ::open(QFile::encodeName(open_path).constData(), O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0) {
+        return false;
+    }
+
+    // NOTE: images on network shares are read directly,
+    // so ask for a larger readahead window
+    if (!growing) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+
+    return true;
+}
+
+qint64 ImageSource::read(void *data, const qint64 max_size) {
+    qint64 total = 0;
+
+    while (total < max_size) {
+        const ssize_t len = ::read(fd, (char *) data + total, max_size - total);
+
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            error_string = QObject::tr("Source image is not readable");
+            return -1;
+        } else if (len > 0) {
+            hash.addData((const char *) data + total, len);
+            total += len;
+        } else if (growing) {
+            // Reached the end of downloaded data, wait for
+            // more unless the download has finished or
+            // failed
+            const bool still_growing = updateGrowing();
+            if (!error_string.isEmpty()) {
+                return -1;
+            }
+
+            if (still_growing) {
+                QThread::msleep(100);
+            }
+        } else {
+            at_end = true;
+            break;
+        }
+    }
+
+    return total;
+}
+
+bool ImageSource::downloadFinished() {
+    if (growing) {
+        updateGrowing();
+    }
+
+    return !growing;
+}
+
+bool ImageSource::atEnd() const {
+    return at_end;
+}
+
+QString ImageSource::errorString() const {
+    return error_string;
+}
+
+QString ImageSource::md5() {
+    return QString(hash.result().toHex());
+}
+
+// Returns whether the image is still being downloaded.
+// If the ".part" file disappeared without a final file
+// appearing, the download failed or was cancelled and
+// the partial file was deleted.
+bool ImageSource::updateGrowing() {
+    if (QFile::exists(part_path)) {
+        return true;
+    }
+
+    growing = false;
+
+    if (!QFile::exists(final_path)) {
+        error_string = QObject::tr("Image download failed");
+    }
+
+    return false;
+}
+
+CacheWriter::CacheWriter(const QString &path)
+: final_path(path)
+, file(path + ".part")
+, hash(QCryptographicHash::Md5) {
+    total = 0;
+    active = false;
+
+    if (!final_path.isEmpty()) {
+        active = file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    }
+}
+
+CacheWriter::~CacheWriter() {
+    // Unfinished copy is incomplete
+    if (active) {
+        file.remove();
+    }
+}
+
+void CacheWriter::write(const void *data, const qint64 size) {
+    static const qint64 block_size = 4096;
+    static const char zero_block[block_size] = {};
+
+    if (!active) {
+        return;
+    }
+
+    const char *bytes = (const char *) data;
+    hash.addData(bytes, size);
+
+    for (qint64 offset = 0; offset < size; offset += block_size) {
+        const qint64 length = qMin(block_size, size - offset);
+        const bool is_zero = (memcmp(bytes + offset, zero_block, length) == 0);
+
+        bool success;
+        if (is_zero) {
+            success = file.seek(total + offset + length);
+        } else {
+            success = (file.write(bytes + offset, length) == length);
+        }
+
+        if (!success) {
+            file.remove();
+            active = false;
+
+            return;
+        }
+    }
+
+    total += size;
+}
+
+void CacheWriter::finish(const QString &source_md5) {
+    if (!active) {
+        return;
+    }
+    active = false;
+
+    // NOTE: trailing zeroes were skipped, so file has to
+    // be extended to the full size
+    const bool resize_success = file.resize(total);
+    file.close();
+
+    QFile::remove(final_path);
+    const bool rename_success = (resize_success && file.rename(final_path));
+    if (!rename_success) {
+        file.remove();
+
+        return;
+    }
+
+    QFile md5_file(final_path + ".md5");
+    const bool md5_open_success = md5_file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    if (md5_open_success) {
+        const QString md5_line = QString("%1 %2\n").arg(QString(hash.result().toHex()), source_md5);
+        md5_file.write(md5_line.toLatin1());
+    } else {
+        QFile::remove(final_path);
+    }
+}
@@ -25,7 +25,6 @@
 
 #include <QDBusUnixFileDescriptor>
 #include <QFile>
-#include <QFileSystemWatcher>
 #include <QObject>
 #include <QProcess>
 
@@ -40,10 +39,12 @@
 #define MEDIAWRITER_LZMA_LIMIT (1024 * 1024 * 256)
 #endif
 
+class ImageSource;
+
 class WriteJob : public QObject {
     Q_OBJECT
 public:
-    explicit WriteJob(const QString &what, const QString &where, const QString &md5_arg);
+    explicit WriteJob(const QString &what, const QString &where, const QString &md5_arg, const bool stream_arg = false, const QString &cache_path_arg = QString());
 
     static int staticOnMediaCheckAdvanced(void *data, long long offset, long long total);
     int onMediaCheckAdvanced(long long offset, long long total);
@@ -55,15 +56,18 @@ public:
     bool check(int fd);
 public slots:
     void work();
-private slots:
-    void onFileChanged(const QString &path);
 
 private:
     QString what;
     QString where;
     QString md5;
+    bool stream;
+    QString cache_path;
     QDBusUnixFileDescriptor fd;
-    QFileSystemWatcher watcher;
+    bool write_announced;
+
+    void reportProgress(ImageSource &source, const qint64 total);
+    bool checkSourceMd5(ImageSource &source);
 };
 
 #endif // WRITEJOB_H